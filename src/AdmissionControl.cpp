@@ -0,0 +1,58 @@
+#include "AdmissionControl.h"
+
+#include <cmath>
+
+// 记录一个排队延迟样本
+// @param signal 样本所属的延迟信号
+// @param delay 延迟，事件循环空闲的一轮记为零
+// @param now 当前时间
+void AdmissionController::observe(DelaySignal signal, Clock::duration delay, Clock::time_point now){
+    SignalState& s = signals[signal];
+    s.lastDelay = delay;
+    if (delay < target){
+        s.firstAbove = Clock::time_point{};
+        s.dropping = false;
+        return;
+    }
+    if (s.firstAbove == Clock::time_point{}){
+        s.firstAbove = now + interval;
+        return;
+    }
+    if (!s.dropping && now >= s.firstAbove){
+        // 另一个信号已在拒绝状态时沿用当前的控制律
+        bool wasDropping = isDropping();
+        s.dropping = true;
+        if (wasDropping)
+            return;
+        // 上一次拒绝状态刚结束不久时沿用其频率，而不是从头开始
+        count = count > 2 && now - dropNext < interval * 16 ? count - 2 : 1;
+        dropNext = now;
+    }
+}
+
+// 是否拒绝当前的连接或请求
+// 拒绝状态中按控制律的时间点拒绝，被拒绝的次数越多，间隔越短
+// @param now 当前时间
+// @return 应当拒绝时返回 true
+bool AdmissionController::shouldShed(Clock::time_point now){
+    if (!isDropping() || now < dropNext)
+        return false;
+    ++count;
+    dropNext = now + std::chrono::duration_cast<Clock::duration>(interval / std::sqrt(count));
+    return true;
+}
+
+// 导出准入控制的指标（Prometheus 文本格式）
+std::string AdmissionController::getMetrics() const {
+    static char const* const reasons[SHED_REASON_COUNT] = {"overload", "max_connections", "vhost_max_connections"};
+    std::string ret;
+    for (uint32_t i = 0; i < SHED_REASON_COUNT; ++i)
+        ret += "admission_shed_total{reason=\"" + std::string(reasons[i]) + "\"} " + std::to_string(shed[i]) + "\n";
+    static char const* const signalNames[DELAY_SIGNAL_COUNT] = {"loop_lag", "sojourn"};
+    ret += "admission_dropping " + std::to_string(isDropping() ? 1 : 0) + "\n";
+    for (uint32_t i = 0; i < DELAY_SIGNAL_COUNT; ++i){
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(signals[i].lastDelay).count();
+        ret += "admission_delay_microseconds{signal=\"" + std::string(signalNames[i]) + "\"} " + std::to_string(us) + "\n";
+    }
+    return ret;
+}
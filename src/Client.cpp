@@ -9,6 +9,7 @@ Client::~Client(){
 // 添加到send queue
 void Client::addToSendQueue(SendQueueItem* item){
     sendQueue.push(item);
+    queuedBytes += item->getSize() - item->getOffset();
 }
 
 // 返回发送队列中当前 SendQueueItem 的数量
@@ -27,6 +28,8 @@ SendQueueItem* Client::nextInSendQueue(){
 void Client::dequeueFromSendQueue(){
     SendQueueItem* item = nextInSendQueue();
     if (item != nullptr){
+        // 未发送完就出队（断开连接时）的部分也不再计入
+        markSent(item->getSize() - item->getOffset());
         sendQueue.pop();
         delete item;
     }
@@ -37,4 +40,5 @@ void Client::clearSendQueue(){
         delete sendQueue.front();
         sendQueue.pop();
     }
+    queuedBytes = 0;
 }
@@ -0,0 +1,175 @@
+#include "CpuTaskPool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// 创建唤醒管道、各工作线程的队列，并启动工作线程
+// @param numThreads 工作线程数
+// @param pendingLimit 所有队列中最多等待的任务数，超出时 submit() 失败
+CpuTaskPool::CpuTaskPool(uint32_t numThreads, uint32_t pendingLimit) : maxPending(pendingLimit){
+    if (pipe(wakePipe) == 0){
+        // 两端都设为非阻塞：写满时丢弃唤醒字节即可（事件循环总会被已写入的字节唤醒）
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(wakePipe[1], F_SETFD, FD_CLOEXEC);
+    }
+    if (numThreads == 0)
+        numThreads = 1;
+    for (uint32_t i = 0; i < numThreads; ++i)
+        queues.push_back(std::make_unique<WorkerQueue>());
+    for (uint32_t i = 0; i < numThreads; ++i)
+        workers.emplace_back(&CpuTaskPool::workerLoop, this, i);
+}
+
+// 通知所有工作线程退出并等待其结束。尚未执行的任务和尚未执行 done 的完成项被丢弃
+CpuTaskPool::~CpuTaskPool(){
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCv.notify_all();
+    for (auto& t : workers)
+        t.join();
+
+    for (auto& q : queues)
+        q->tasks.clear();
+    Completion* node = completed.exchange(nullptr);
+    while (node != nullptr){
+        Completion* next = node->next;
+        delete node;
+        node = next;
+    }
+
+    for (auto& fd : wakePipe){
+        if (fd != -1){
+            close(fd);
+            fd = -1;
+        }
+    }
+}
+
+// 取出一项任务：先从自己队列的尾部取（最近提交的任务，缓存更热），再从其他队列的头部窃取
+// @param self 工作线程下标
+// @param task 取出的任务
+// @return 所有队列都为空时返回 false
+bool CpuTaskPool::takeTask(uint32_t self, CpuTask& task){
+    uint32_t n = queues.size();
+    for (uint32_t i = 0; i < n; ++i){
+        WorkerQueue& q = *queues[(self + i) % n];
+        if (q.depth.load(std::memory_order_relaxed) == 0)
+            continue;
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            continue;
+        if (i == 0){
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            queues[self]->stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+        q.depth.store(q.tasks.size(), std::memory_order_relaxed);
+        queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+// 工作线程主循环：取出任务执行 work，然后放入完成链表；没有任务时休眠
+// @param self 工作线程下标
+void CpuTaskPool::workerLoop(uint32_t self){
+    while (!stopping){
+        CpuTask task;
+        if (!takeTask(self, task)){
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCv.wait(lock, [this]{ return stopping || queued.load() > 0; });
+            continue;
+        }
+
+        if (task.work)
+            task.work();
+        queues[self]->executed.fetch_add(1, std::memory_order_relaxed);
+        // 任务连同 work 捕获的变量一起交回事件循环线程，在那里析构
+        postCompletion(std::move(task));
+    }
+}
+
+// 把完成的任务压入无锁链表，链表原来为空时唤醒事件循环
+// 事件循环先清空管道再取走整个链表，因此链表非空时管道中必然有未读的唤醒字节
+void CpuTaskPool::postCompletion(CpuTask task){
+    auto node = new Completion{std::move(task)};
+    Completion* head = completed.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!completed.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+
+    if (head == nullptr){
+        char b = 1;
+        [[maybe_unused]] ssize_t n = write(wakePipe[1], &b, 1);
+    }
+}
+
+// 提交一项任务，只能在事件循环线程上调用
+// 任务轮流放入各工作线程的队列，空闲的工作线程会从其他队列窃取
+// @param task 要执行的任务
+// @return 队列已满或线程池正在停止时返回 false，调用者应自行同步处理
+bool CpuTaskPool::submit(CpuTask task){
+    if (stopping || queued.load() >= maxPending)
+        return false;
+
+    WorkerQueue& q = *queues[nextQueue];
+    nextQueue = (nextQueue + 1) % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(std::move(task));
+        q.depth.store(q.tasks.size(), std::memory_order_relaxed);
+    }
+    queued.fetch_add(1);
+
+    // 先获取再释放休眠锁，保证正在检查条件的工作线程不会错过通知
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCv.notify_one();
+    return true;
+}
+
+// 按完成顺序执行所有已完成任务的 done 回调
+// 必须在事件循环线程上调用（唤醒描述符可读时）
+void CpuTaskPool::runCompletions(){
+    // 先清空管道中的唤醒字节，再取走链表
+    char buf[256];
+    while (read(wakePipe[0], buf, sizeof(buf)) > 0){}
+
+    Completion* node = completed.exchange(nullptr, std::memory_order_acquire);
+    // 链表是后完成的在前，反转后按完成顺序执行
+    Completion* ordered = nullptr;
+    while (node != nullptr){
+        Completion* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    while (ordered != nullptr){
+        Completion* next = ordered->next;
+        if (ordered->task.done)
+            ordered->task.done();
+        delete ordered;
+        ordered = next;
+    }
+}
+
+// 导出各工作线程的队列深度、执行数和窃取数（Prometheus 文本格式）
+std::string CpuTaskPool::getMetrics() const {
+    std::string ret;
+    for (size_t i = 0; i < queues.size(); ++i){
+        std::string label = "{worker=\"" + std::to_string(i) + "\"}";
+        ret += "cpu_pool_queue_depth" + label + " " + std::to_string(queues[i]->depth.load(std::memory_order_relaxed)) + "\n";
+        ret += "cpu_pool_executed_total" + label + " " + std::to_string(queues[i]->executed.load(std::memory_order_relaxed)) + "\n";
+        ret += "cpu_pool_steals_total" + label + " " + std::to_string(queues[i]->stolen.load(std::memory_order_relaxed)) + "\n";
+    }
+    ret += "cpu_pool_queued " + std::to_string(queued.load()) + "\n";
+    return ret;
+}
@@ -0,0 +1,198 @@
+#include "DirListing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <dirent.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+
+// getdents64 返回的记录格式（glibc 未导出该结构）
+struct linux_dirent64{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// 取 stat 中 mtime 的纳秒部分
+static long mtimeNsecOf(struct stat const& sb){
+#if defined(__linux__)
+    return sb.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return sb.st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+// 转义 JSON 字符串中的特殊字符
+static void appendJsonStr(std::string& out, std::string const& s){
+    out += '"';
+    for (char c : s){
+        switch (c){
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20){
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    out += esc;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// 转义 HTML 中的特殊字符
+static void appendHtmlStr(std::string& out, std::string const& s){
+    for (char c : s){
+        switch (c){
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '&': out += "&amp;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += c;
+        }
+    }
+}
+
+// 从已打开的目录描述符加载条目名
+// Linux 下直接以 DIR_BATCH_BYTES 为单位批量调用 getdents64，不经过 readdir 的逐条拷贝
+// @param fd 目录描述符（读取位置会被重置），调用者须保证没有其他线程同时读取同一个文件描述
+// @param sb 目录的 stat 结果，用于之后判断列表是否过期
+// @return 成功返回 true
+bool DirListing::load(int32_t fd, struct stat const& sb){
+    names.clear();
+    mtime = sb.st_mtime;
+    mtimeNsec = mtimeNsecOf(sb);
+    ino = sb.st_ino;
+
+#ifdef __linux__
+    if (lseek(fd, 0, SEEK_SET) == -1)
+        return false;
+    auto buf = std::make_unique<char[]>(DIR_BATCH_BYTES);
+    long nread = 0;
+    while ((nread = syscall(SYS_getdents64, fd, buf.get(), DIR_BATCH_BYTES)) > 0){
+        for (long bpos = 0; bpos < nread; ){
+            auto d = (const struct linux_dirent64*)(buf.get() + bpos);
+            bpos += d->d_reclen;
+            // 跳过隐藏文件 (以 . 开头)
+            if (d->d_name[0] == '.')
+                continue;
+            names.emplace_back(d->d_name);
+        }
+    }
+    if (nread < 0)
+        return false;
+#else
+    // fdopendir 会接管描述符，因此传入副本，缓存中的 fd 保持打开
+    int32_t dfd = dup(fd);
+    if (dfd == -1)
+        return false;
+    DIR* dir = fdopendir(dfd);
+    if (dir == nullptr){
+        close(dfd);
+        return false;
+    }
+    rewinddir(dir);
+    const struct dirent* ent = nullptr;
+    while ((ent = readdir(dir)) != nullptr){
+        if (ent->d_name[0] == '.')
+            continue;
+        names.emplace_back(ent->d_name);
+    }
+    closedir(dir);
+#endif
+
+    // 排序后分页结果在两次请求之间保持稳定
+    std::sort(names.begin(), names.end());
+    return true;
+}
+
+// 目录在加载之后是否被修改过
+bool DirListing::isStale(struct stat const& sb) const {
+    return sb.st_mtime != mtime || mtimeNsecOf(sb) != mtimeNsec || sb.st_ino != ino;
+}
+
+// 渲染一页 HTML 目录列表
+// @param uri 目录的 URI（以 / 结尾）
+// @param page 页码，从 1 开始
+// @return HTML 字符串，页码越界时返回空字符串
+std::string DirListing::renderHtml(std::string const& uri, uint32_t page) const {
+    uint32_t pages = getNumPages();
+    if (page == 0 || page > pages)
+        return "";
+
+    uint32_t first = (page - 1) * DIR_PAGE_SIZE;
+    uint32_t last = std::min<uint32_t>(first + DIR_PAGE_SIZE, names.size());
+
+    std::string ret;
+    ret.reserve(128 + (last - first) * 64);
+    ret += "<html><head><title>";
+    appendHtmlStr(ret, uri);
+    ret += "</title></head><body>";
+    // 页面标题，显示所列目录的 URI
+    ret += "<h1>Index of ";
+    appendHtmlStr(ret, uri);
+    ret += "</h1><hr /><br />";
+    // 显示目录中对象的链接
+    for (uint32_t i = first; i < last; ++i){
+        ret += "<a href=\"";
+        appendHtmlStr(ret, uri + names[i]);
+        ret += "\">";
+        appendHtmlStr(ret, names[i]);
+        ret += "</a><br />";
+    }
+    // 分页导航
+    if (pages > 1){
+        ret += "<hr />";
+        if (page > 1)
+            ret += "<a href=\"?page=" + std::to_string(page - 1) + "\">&laquo; prev</a> ";
+        ret += "page " + std::to_string(page) + " of " + std::to_string(pages);
+        if (page < pages)
+            ret += " <a href=\"?page=" + std::to_string(page + 1) + "\">next &raquo;</a>";
+    }
+    ret += "</body></html>";
+    return ret;
+}
+
+// 渲染一页 JSON 目录列表，供工具使用
+// {"path":"/dir/","page":1,"pages":3,"total":2500,"entries":["a","b",...]}
+// @param uri 目录的 URI（以 / 结尾）
+// @param page 页码，从 1 开始
+// @return JSON 字符串，页码越界时返回空字符串
+std::string DirListing::renderJson(std::string const& uri, uint32_t page) const {
+    uint32_t pages = getNumPages();
+    if (page == 0 || page > pages)
+        return "";
+
+    uint32_t first = (page - 1) * DIR_PAGE_SIZE;
+    uint32_t last = std::min<uint32_t>(first + DIR_PAGE_SIZE, names.size());
+
+    std::string ret;
+    ret.reserve(96 + (last - first) * 32);
+    ret += "{\"path\":";
+    appendJsonStr(ret, uri);
+    ret += ",\"page\":" + std::to_string(page);
+    ret += ",\"pages\":" + std::to_string(pages);
+    ret += ",\"total\":" + std::to_string(names.size());
+    ret += ",\"entries\":[";
+    for (uint32_t i = first; i < last; ++i){
+        if (i != first)
+            ret += ',';
+        appendJsonStr(ret, names[i]);
+    }
+    ret += "]}";
+    return ret;
+}
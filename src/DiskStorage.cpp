@@ -0,0 +1,469 @@
+#include "DiskStorage.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// 有效文件可用作目录索引
+const static std::vector<std::string> g_validIndexes = {
+    "index.html",
+    "index.htm",
+};
+
+DiskStorage::DiskStorage(std::string const& base) : baseDiskPath(base), fdCache(base){
+    if (fdCache.getRootFd() == -1)
+        std::cout << "Disk path " << baseDiskPath << " is not a readable directory" << std::endl;
+#ifdef __linux__
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+DiskStorage::~DiskStorage(){
+    if (notifyFd != -1){
+        close(notifyFd);
+        notifyFd = -1;
+    }
+}
+
+// 读取文件
+// 从已打开的描述符读取文件并返回相应的资源对象
+// 这将创建一个新的资源对象--如果返回值不是空值，调用者应将其处理掉
+// @param uri 文件的 URI（用于确定文件名和扩展名）
+// @param fd FdCache 中已打开的文件描述符
+// @param sb 填充 stat 结构
+// 成功加载后返回资源对象
+std::unique_ptr<Resource> DiskStorage::readFile(std::string const& uri, int32_t fd, struct stat const& sb){
+    // 确保webserver User 拥有文件
+    if (!(sb.st_mode & S_IRWXU))
+        return nullptr;
+    // 创建新资源对象并设置内容
+    auto res = std::make_unique<Resource>(uri);
+    std::string name = res->getName();
+    if (name.length() == 0)
+        return nullptr;
+    
+    // 始终禁止隐藏文件
+    if (name.starts_with(".")) {
+        return nullptr;
+    }
+
+    // 获取文件大小
+    uint32_t len = sb.st_size;
+
+    // 为文件内容分配 memory 并读取内容
+    // 使用 pread 不会移动描述符的偏移量，缓存中的 fd 可以被重复读取
+    auto fdata = new uint8_t[len];
+    uint32_t off = 0;
+    while (off < len){
+        ssize_t n = pread(fd, fdata + off, len - off, off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0){
+            // 文件在 stat 之后被截断或读取出错
+            delete[] fdata;
+            return nullptr;
+        }
+        off += n;
+    }
+
+    if (auto mimetype = lookupMimeType(res->getExtension());mimetype.length() != 0){
+        res->setMimeType(mimetype);
+    }
+    else{
+        res->setMimeType("application/octet-stream");
+    }
+
+    res->setData(fdata, len);
+    res->setFileStat(sb.st_ino, sb.st_mtime);
+    return res;
+}
+
+// 从查询字符串中取出参数值
+// @param query "?" 之后的查询字符串
+// @param key 参数名
+// @return 参数值，不存在时返回空字符串
+static std::string getQueryParam(std::string const& query, std::string const& key){
+    size_t pos = 0;
+    while (pos < query.length()){
+        size_t amp = query.find('&', pos);
+        if (amp == std::string::npos)
+            amp = query.length();
+        if (query.compare(pos, key.length(), key) == 0 && pos + key.length() < amp && query[pos + key.length()] == '=')
+            return query.substr(pos + key.length() + 1, amp - pos - key.length() - 1);
+        pos = amp + 1;
+    }
+    return "";
+}
+
+// 读取目录
+// 从磁盘读取目录（列表或索引）到资源对象中
+// 这将创建一个新的资源对象--如果返回值不是空值，调用者应将其处理掉
+// @param uri 目录的 URI
+// @param sb 填充 stat 结构
+// @param query 查询字符串，支持 page=<n>（分页）和 format=json
+// @param lock 调用者持有的 lookupMutex，读取索引文件前释放
+// 成功加载后返回资源对象
+std::unique_ptr<Resource> DiskStorage::readDirectory(std::string uri, struct stat const& sb, std::string const& query,
+                                                      std::unique_lock<std::mutex>& lock){
+    // 如果路径末尾没有 /，则以 / 结尾（以保持一致)
+    if (uri.empty() || uri[uri.length() - 1] != '/')
+        uri += "/";
+    // 探测有效索引（通过 FdCache，命中时不产生系统调用）
+    for (auto const& index : g_validIndexes){
+        std::string loadIndex = uri + index;
+        auto idx = fdCache.lookup(loadIndex);
+        // 找到合适的索引文件加载并返回客户端
+        if (idx != nullptr && idx->err == 0 && S_ISREG(idx->sb.st_mode)){
+            // 复制描述符后释放锁，在锁外读取文件内容
+            struct stat isb = idx->sb;
+            int32_t fd = dup(idx->fd);
+            lock.unlock();
+            if (fd == -1)
+                return nullptr;
+            auto res = readFile(loadIndex, fd, isb);
+            close(fd);
+            return res;
+        }
+    }
+    // 确保网络服务器 USER 拥有该目录
+    if (!(sb.st_mode & S_IRWXU))
+        return nullptr;
+
+    // 探测索引时目录条目可能已被淘汰，重新查找
+    auto dir = fdCache.lookup(uri);
+    if (dir == nullptr || dir->err != 0)
+        return nullptr;
+
+    // 返回时已释放锁，之后的渲染在锁外进行
+    auto listing = getDirListing(uri, dir->fd, dir->sb, lock);
+    if (listing == nullptr)
+        return nullptr;
+
+    uint32_t page = 1;
+    if (std::string pstr = getQueryParam(query, "page"); !pstr.empty())
+        page = atoi(pstr.c_str());
+
+    // 生成 HTML（或 JSON）目录列表的一页
+    bool json = getQueryParam(query, "format") == "json";
+    std::string body = json ? listing->renderJson(uri, page) : listing->renderHtml(uri, page);
+    if (body.empty())
+        return nullptr;
+
+    uint32_t slen = body.length();
+    auto sdata = new uint8_t[slen];
+    memcpy(sdata, body.data(), slen);
+
+    auto res = std::make_unique<Resource>(uri, true);
+    res->setMimeType(json ? "application/json" : "text/html");
+    res->setData(sdata, slen);
+    return res;
+}
+
+// 获取目录列表
+// 缓存命中且目录 mtime 未变化时直接返回，否则在锁外通过目录描述符重新加载，完成后再放入缓存
+// @param uri 目录的 URI（以 / 结尾）
+// @param fd FdCache 中已打开的目录描述符
+// @param sb 目录当前的 stat 结果
+// @param lock 调用者持有的 lookupMutex，返回时已释放
+// @return 目录列表，读取失败时返回 NULL
+std::shared_ptr<DirListing const> DiskStorage::getDirListing(std::string const& uri, int32_t fd, struct stat const& sb,
+                                                             std::unique_lock<std::mutex>& lock){
+    if (auto it = dirListings.find(uri); it != dirListings.end() && !it->second->isStale(sb)){
+        auto listing = it->second;
+        lock.unlock();
+        return listing;
+    }
+
+    // 为读取打开新的文件描述：dup 出的描述符与缓存中的共享读取位置，锁外的并发读取会互相干扰
+    int32_t dfd = openat(fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    lock.unlock();
+    if (dfd == -1)
+        return nullptr;
+    auto listing = std::make_shared<DirListing>();
+    bool ok = listing->load(dfd, sb);
+    close(dfd);
+    if (!ok)
+        return nullptr;
+
+    lock.lock();
+    // 缓存已满时丢弃任意一个目录列表
+    if (dirListings.size() >= DIR_CACHE_MAX && !dirListings.contains(uri))
+        dirListings.erase(dirListings.begin());
+    dirListings.insert_or_assign(uri, listing);
+    lock.unlock();
+    return listing;
+}
+
+// 监视 URI 最近的存在祖先目录
+// 请求的路径可能整段都不存在（例如扫描器探测的 /wp-admin/x.php），因此逐级向上查找
+// 调用者持有 lookupMutex；inotify_add_watch 会解析路径，在 notifyMutex 之外调用
+// @param uri 不存在的 URI
+// @return inotify wd，无法监视时返回 -1
+int32_t DiskStorage::watchAncestor(std::string const& uri){
+#ifdef __linux__
+    if (notifyFd == -1)
+        return -1;
+    std::string dir = uri;
+    while (!dir.empty()){
+        // 去掉末尾的 /，再截取到上一级目录（保留结尾的 /）
+        if (dir.size() > 1 && dir[dir.size() - 1] == '/')
+            dir.pop_back();
+        size_t slash = dir.find_last_of('/');
+        if (slash == std::string::npos)
+            return -1;
+        dir = dir.substr(0, slash + 1);
+
+        {
+            std::lock_guard<std::mutex> nlock(notifyMutex);
+            if (auto it = dirWatches.find(dir); it != dirWatches.end())
+                return it->second;
+        }
+
+        auto entry = fdCache.lookup(dir);
+        if (entry == nullptr || entry->err != 0 || !S_ISDIR(entry->sb.st_mode)){
+            if (dir == "/")
+                return -1;
+            continue;
+        }
+
+        int32_t wd = inotify_add_watch(notifyFd, (baseDiskPath + dir).c_str(),
+                                       IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE |
+                                       IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_ONLYDIR);
+        if (wd == -1)
+            return -1;
+        std::lock_guard<std::mutex> nlock(notifyMutex);
+        // 登记之前事件循环已经收到了这个 wd 的事件：目录刚刚变化过，不依赖它缓存
+        if (unknownWds.erase(wd) > 0)
+            return -1;
+        watchDirs.insert_or_assign(wd, dir);
+        dirWatches.insert_or_assign(dir, wd);
+        return wd;
+    }
+#endif
+    return -1;
+}
+
+// 记录一个不存在的 URI
+// 只有能够监视到目录变更时才缓存，否则新建的文件将永远返回 404
+void DiskStorage::addNegative(std::string const& uri){
+    {
+        std::lock_guard<std::mutex> nlock(notifyMutex);
+        if (negEntries.contains(uri))
+            return;
+    }
+    int32_t wd = watchAncestor(uri);
+    if (wd == -1)
+        return;
+    // 事件循环不再和 load() 互斥，查找之后、监视生效之前文件可能已被创建：
+    // 监视生效后重新确认一次，并且期间没有处理过任何变更通知
+    uint64_t gen = 0;
+    {
+        std::lock_guard<std::mutex> nlock(notifyMutex);
+        gen = notifyGen;
+    }
+    struct stat sb;
+    if (stat((baseDiskPath + uri).c_str(), &sb) == 0 || (errno != ENOENT && errno != ENOTDIR))
+        return;
+    std::lock_guard<std::mutex> nlock(notifyMutex);
+    // 监视已被移除（目录在此期间被删除）或目录刚刚变化过
+    if (gen != notifyGen || !watchDirs.contains(wd) || negEntries.contains(uri))
+        return;
+    // 达到上限时淘汰最久未命中的条目
+    if (negLru.size() >= NEG_CACHE_MAX){
+        negEntries.erase(negLru.back());
+        negLru.pop_back();
+    }
+    negLru.push_front(uri);
+    negEntries.try_emplace(uri, NegEntry{wd, negLru.begin()});
+}
+
+// 删除挂在 wd 下的所有负缓存条目（同时从 LRU 链表中删除），调用者持有 notifyMutex
+void DiskStorage::dropNegatives(int32_t wd){
+    std::erase_if(negEntries, [this, wd](auto const& e){
+        if (e.second.wd != wd)
+            return false;
+        negLru.erase(e.second.pos);
+        return true;
+    });
+}
+
+// 查询 URI 是否在负缓存中
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @return 监视其祖先目录的 inotify wd，不在负缓存中时返回 -1
+int32_t DiskStorage::getMissingWatch(std::string const& requestUri){
+    std::lock_guard<std::mutex> nlock(notifyMutex);
+    auto it = negEntries.find(requestUri.substr(0, requestUri.find('?')));
+    return it == negEntries.end() ? -1 : it->second.wd;
+}
+
+// 把事件循环登记的失效应用到 FdCache，调用者持有 lookupMutex（在 I/O 线程上）
+void DiskStorage::applyInvalidations(){
+    std::vector<std::string> files;
+    std::vector<std::string> dirs;
+    {
+        std::lock_guard<std::mutex> nlock(notifyMutex);
+        files.swap(staleUris);
+        dirs.swap(staleDirs);
+    }
+    for (auto const& uri : files)
+        fdCache.invalidate(uri);
+    for (auto const& dir : dirs)
+        fdCache.invalidatePrefix(dir);
+}
+
+// 处理目录变更通知
+// 在 notifyFd 可读时由事件循环调用：立即删除受影响目录下的负缓存，
+// FdCache 的失效只登记下来，由 I/O 线程在下一次查找前应用。
+// 只取 notifyMutex（持有期间没有系统调用），不会等待 I/O 线程在 lookupMutex 下的文件系统访问
+// @return 发生变化的被监视目录的 wd
+std::vector<int32_t> DiskStorage::processNotifications(){
+    std::vector<int32_t> changed;
+#ifdef __linux__
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t len = 0;
+    while ((len = read(notifyFd, buf, sizeof(buf))) > 0){
+        std::lock_guard<std::mutex> nlock(notifyMutex);
+        notifyGen++;
+        for (char* p = buf; p < buf + len; ){
+            auto ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            auto it = watchDirs.find(ev->wd);
+            if (it == watchDirs.end()){
+                // I/O 线程已添加监视但尚未登记
+                if (unknownWds.size() >= NEG_CACHE_MAX)
+                    unknownWds.clear();
+                unknownWds.insert(ev->wd);
+                continue;
+            }
+            std::string dir = it->second;
+            dropNegatives(ev->wd);
+            changed.push_back(ev->wd);
+
+            // 目录本身的 stat（列表内容）以及发生变化的子项都需要重新解析
+            staleUris.push_back(dir);
+            if (dir.size() > 1)
+                staleUris.push_back(dir.substr(0, dir.size() - 1));
+            if (ev->len > 0){
+                std::string child = dir + ev->name;
+                staleUris.push_back(child);
+                // 子目录被创建、移入、移出或删除：其下缓存的结果（包括不存在的错误）全部失效
+                if (ev->mask & IN_ISDIR)
+                    staleDirs.push_back(child + "/");
+                else
+                    staleUris.push_back(child + "/");
+            }
+
+            // 监视已被内核移除（目录被删除或卸载）
+            if (ev->mask & IN_IGNORED){
+                dirWatches.erase(dir);
+                watchDirs.erase(it);
+            }
+        }
+    }
+#endif
+    return changed;
+}
+
+// 从文件系统读取资源
+// 返回一个新的资源对象--如果返回值不是空值，调用者应将其处理掉
+// @param requestUri 请求中发送的 URI（可带查询字符串）
+// @reutn 如果无法加载资源，则返回 NULL
+std::unique_ptr<Resource> DiskStorage::load(std::string const& requestUri) {
+    if (requestUri.length() > 255 || requestUri.empty())
+        return nullptr;
+
+    // 分离查询字符串（仅目录列表使用）
+    std::string uri = requestUri;
+    std::string query = "";
+    if (size_t qpos = requestUri.find('?'); qpos != std::string::npos){
+        uri = requestUri.substr(0, qpos);
+        query = requestUri.substr(qpos + 1);
+    }
+    if (uri.empty())
+        return nullptr;
+
+    // 不允许目录遍历
+    // 支持 RESOLVE_BENEATH 时由内核保证路径不会逃出 docroot，否则退回到子串检查
+    if (!fdCache.isConfined() && (uri.contains("../") || uri.contains("/..")))
+        return nullptr;
+    
+    std::unique_lock<std::mutex> lock(lookupMutex);
+    applyInvalidations();
+
+    // 已知不存在的 URI 直接从内存返回，不再 stat 或探测索引
+    {
+        std::lock_guard<std::mutex> nlock(notifyMutex);
+        if (auto neg = negEntries.find(uri); neg != negEntries.end()){
+            negLru.splice(negLru.begin(), negLru, neg->second.pos);
+            return nullptr;
+        }
+    }
+
+    // 通过 FdCache 获取描述符和 stat 信息：确定它是目录还是文件，检查它是否为组/用户所有，修改次数
+    bool hit = false;
+    auto entry = fdCache.lookup(uri, &hit);
+    if (entry == nullptr)
+        return nullptr;
+    if (entry->err != 0){
+        // 只根据刚刚解析的结果记录负缓存：缓存中的错误可能早于监视建立之前的目录变更
+        if (!hit && (entry->err == ENOENT || entry->err == ENOTDIR))
+            addNegative(uri);
+        return nullptr;
+    }
+    
+    // 探测目录索引会继续查找缓存，先复制 stat 结果
+    struct stat sb = entry->sb;
+    if (S_ISDIR(sb.st_mode)){
+        // 从 FS 将目录列表或索引读入内存
+        return readDirectory(uri, sb, query, lock);
+    } else if (S_ISREG(sb.st_mode)){
+        // 复制描述符后释放锁，在锁外将文件从 FS 加载到内存中
+        int32_t fd = dup(entry->fd);
+        lock.unlock();
+        if (fd == -1)
+            return nullptr;
+        auto res = readFile(uri, fd, sb);
+        close(fd);
+        return res;
+    }
+    return nullptr;
+}
+
+// 内容缓存中的资源是否仍与磁盘上的文件一致
+// 通过 FdCache 比较 inode、mtime 和大小（FdCache 未过期时不产生系统调用）
+// 需要 lookupMutex，FdCache 过期时还会 stat，只在 I/O 线程上调用
+// @param res 之前由 load() 加载的资源
+bool DiskStorage::isFresh(Resource const& res){
+    std::lock_guard<std::mutex> lock(lookupMutex);
+    applyInvalidations();
+    auto entry = fdCache.lookup(res.getLocation());
+    return entry != nullptr && entry->err == 0 &&
+           (uint64_t)entry->sb.st_ino == res.getInode() &&
+           (int64_t)entry->sb.st_mtime == res.getMtime() &&
+           (uint64_t)entry->sb.st_size == res.getSize();
+}
+
+// 让内核异步地把文件读入页缓存
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+void DiskStorage::prefetch(std::string const& requestUri){
+    std::string uri = requestUri.substr(0, requestUri.find('?'));
+    std::lock_guard<std::mutex> lock(lookupMutex);
+    applyInvalidations();
+    auto entry = fdCache.lookup(uri);
+    if (entry == nullptr || entry->err != 0 || !S_ISREG(entry->sb.st_mode))
+        return;
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(entry->fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+}
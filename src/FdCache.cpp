@@ -0,0 +1,155 @@
+#include "FdCache.h"
+
+#include <cerrno>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#endif
+
+// 打开 docroot 目录并探测内核是否支持 openat2(RESOLVE_BENEATH)
+// @param root docroot 的磁盘路径
+// @param entryTtl 缓存条目的有效期（秒）
+// @param entryLimit 最多缓存的条目数
+FdCache::FdCache(std::string const& root, time_t entryTtl, uint32_t entryLimit) : ttl(entryTtl), maxEntries(entryLimit){
+    rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#if defined(__linux__) && defined(SYS_openat2)
+    if (rootFd != -1){
+        struct open_how how = {};
+        how.flags = O_RDONLY | O_CLOEXEC;
+        how.resolve = RESOLVE_BENEATH;
+        int32_t probe = syscall(SYS_openat2, rootFd, ".", &how, sizeof(how));
+        if (probe != -1){
+            close(probe);
+            beneathSupported = true;
+        }
+    }
+#endif
+}
+
+FdCache::~FdCache(){
+    clear();
+    if (rootFd != -1){
+        close(rootFd);
+        rootFd = -1;
+    }
+}
+
+// 相对 docroot 打开路径
+// @param relPath 不以 / 开头的相对路径，"." 表示 docroot 本身
+// @return 文件描述符，失败返回 -1 并设置 errno
+int32_t FdCache::openBeneath(std::string const& relPath){
+#if defined(__linux__) && defined(SYS_openat2)
+    if (beneathSupported){
+        struct open_how how = {};
+        how.flags = O_RDONLY | O_CLOEXEC | O_NONBLOCK;
+        // RESOLVE_BENEATH 在内核中拒绝 ".."、绝对路径以及指向 docroot 之外的符号链接
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        return syscall(SYS_openat2, rootFd, relPath.c_str(), &how, sizeof(how));
+    }
+#endif
+    return openat(rootFd, relPath.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+}
+
+// 缓存已满时腾出空间：先丢弃过期条目，仍然满则丢弃任意一条
+void FdCache::evict(){
+    time_t now = time(nullptr);
+    for (auto it = entries.begin(); it != entries.end();){
+        if (it->second.expires <= now){
+            if (it->second.fd != -1)
+                close(it->second.fd);
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (entries.size() >= maxEntries && !entries.empty()){
+        auto it = entries.begin();
+        if (it->second.fd != -1)
+            close(it->second.fd);
+        entries.erase(it);
+    }
+}
+
+// 查找 URI 对应的文件
+// 命中且未过期时直接返回缓存结果，不产生任何系统调用
+// @param uri 请求中的 URI（以 / 开头）
+// @param hit 不为 NULL 时输出结果是否来自缓存（而不是刚刚解析的）
+// @return 缓存条目，err 非 0 表示文件不存在或无法打开。docroot 无效时返回 NULL
+FdCacheEntry const* FdCache::lookup(std::string const& uri, bool* hit){
+    if (hit != nullptr)
+        *hit = false;
+    if (rootFd == -1)
+        return nullptr;
+
+    time_t now = time(nullptr);
+    auto it = entries.find(uri);
+    if (it != entries.end()){
+        if (it->second.expires > now){
+            if (hit != nullptr)
+                *hit = true;
+            return &it->second;
+        }
+        // 已过期，关闭旧描述符后重新解析
+        if (it->second.fd != -1)
+            close(it->second.fd);
+        entries.erase(it);
+    }
+
+    if (entries.size() >= maxEntries)
+        evict();
+
+    // 去掉开头的 /，使路径相对于 docroot
+    size_t start = uri.find_first_not_of('/');
+    std::string relPath = (start == std::string::npos) ? "." : uri.substr(start);
+
+    FdCacheEntry entry;
+    entry.expires = now + ttl;
+    entry.fd = openBeneath(relPath);
+    if (entry.fd == -1){
+        entry.err = errno;
+    } else if (fstat(entry.fd, &entry.sb) != 0){
+        entry.err = errno;
+        close(entry.fd);
+        entry.fd = -1;
+    }
+
+    auto ins = entries.insert_or_assign(uri, entry).first;
+    return &ins->second;
+}
+
+// 使单个 URI 的缓存失效
+void FdCache::invalidate(std::string const& uri){
+    auto it = entries.find(uri);
+    if (it == entries.end())
+        return;
+    if (it->second.fd != -1)
+        close(it->second.fd);
+    entries.erase(it);
+}
+
+// 使某个目录下所有 URI 的缓存失效（目录被创建、移入、移出或删除时，其下的结果都不再可信）
+// @param prefix 目录的 URI，以 / 结尾
+void FdCache::invalidatePrefix(std::string const& prefix){
+    for (auto it = entries.begin(); it != entries.end();){
+        if (it->first.starts_with(prefix)){
+            if (it->second.fd != -1)
+                close(it->second.fd);
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// 关闭所有缓存的描述符并清空缓存
+void FdCache::clear(){
+    for (auto const& [uri, entry] : entries){
+        if (entry.fd != -1)
+            close(entry.fd);
+    }
+    entries.clear();
+}
@@ -255,6 +255,25 @@ std::string HTTPMessage::getHeaderValue(std::string const& key) const{
     return it->second;
 }
 
+// 获取header value，不复制
+// 与 getHeaderValue 相同的查找规则，但返回指向header map 的视图，小写变体在栈上构造
+// @param key header key（最长 64 字节）
+// @return header value 的视图，在消息对象被修改或销毁前有效；不存在时为空
+std::string_view HTTPMessage::getHeaderView(std::string_view key) const{
+    auto it = headers.find(key);
+    if (it == headers.end()){
+        char key_lower[64];
+        if (key.length() > sizeof(key_lower))
+            return {};
+        for (uint32_t i = 0; i < key.length(); ++i)
+            key_lower[i] = tolower((unsigned char)key[i]);
+        it = headers.find(std::string_view(key_lower, key.length()));
+        if (it == headers.end())
+            return {};
+    }
+    return it->second;
+}
+
 // get header string
 // 从索引位置的header map 中获取格式完整的header:value string
 std::string HTTPMessage::getHeaderStr(int32_t index) const{
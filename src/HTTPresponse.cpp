@@ -23,8 +23,12 @@ void HTTPResponse::determineStatusCode(){
         status = Status(BAD_REQUEST);
     }else if(reason.find("NOT_FOUND") != std::string::npos){
         status = Status(NOT_FOUND);
+    }else if (reason.find("Too Many Requests") != std::string::npos){
+        status = Status(TOO_MANY_REQUESTS);
     }else if (reason.find("Server Error") != std::string::npos){
         status = Status(SERVER_ERROR);
+    }else if (reason.find("Service Unavailable") != std::string::npos){
+        status = Status(SERVICE_UNAVAILABLE);
     }else if (reason.find("Not Implemented")){
         status = Status(NOT_IMPLEMENTED);
     }else {
@@ -47,12 +51,18 @@ void HTTPResponse::determineReasonStr() {
     case Status(NOT_FOUND):
         reason = "Not Found";
         break;
+    case Status(TOO_MANY_REQUESTS):
+        reason = "Too Many Requests";
+        break;
     case Status(SERVER_ERROR):
         reason = "Internal Server Error";
         break;
     case Status(NOT_IMPLEMENTED):
         reason = "Not Implemented";
         break;
+    case Status(SERVICE_UNAVAILABLE):
+        reason = "Service Unavailable";
+        break;
     default:
         break;
     }
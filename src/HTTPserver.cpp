@@ -1,18 +1,24 @@
 #include "HTTPserver.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <ctime>
+#include <chrono>
 #include <memory>
 #include <iostream>
+#include <cerrno>
+#include <cstring>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 
 #ifdef __linux__
 #include <kqueue/sys/event.h>
@@ -20,6 +26,13 @@
 #include <sys/event.h>
 #endif
 
+// 没有 MSG_MORE 的平台上每段单独发送
+#ifdef MSG_MORE
+constexpr int32_t SEND_MORE_FLAG = MSG_MORE;
+#else
+constexpr int32_t SEND_MORE_FLAG = 0;
+#endif
+
 
 // server 构造函数
 // 初始化状态和服务器变量
@@ -28,41 +41,231 @@
 // @param diskpath vhost 服务文件夹的路径
 // @param drop_uid UID 在 bind() 之后设置为 uid。 如果为 0 则忽略
 // @param drop_gid 在 bind() 后设置为 GID。 若为 0 则忽略
+// @param io_threads 磁盘 I/O 线程池的线程数
+// @param storage diskpath 的存储后端："disk"、"memory" 或 "pack"
+// @param cpu_threads CPU 线程池的线程数
 HTTPServer::HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port,
-                        std::string const& diskpath, int32_t drop_uid, int32_t drop_gid):
+                        std::string const& diskpath, int32_t drop_uid, int32_t drop_gid,
+                        uint32_t io_threads, std::string const& storage, uint32_t cpu_threads):
                         listenPort(port),
                         dropUid(drop_uid),
-                        dropGid(drop_gid){
+                        dropGid(drop_gid),
+                        ioThreads(io_threads),
+                        cpuThreads(cpu_threads){
     std::cout << "Port: " << port << std::endl;
-    std::cout << "Disk path: " << diskpath << std::endl;
-    // 在磁盘上创建一个为基本路径 ./htdocs 服务的资源主机
-    auto resHost = std::make_shared<ResourceHost>(diskpath);
-    hostList.push_back(resHost);
-    // 始终为 localhost/127.0.0.1 提供服务（这就是为什么我们只在 hostList 中添加了一个 ResourceHost 的原因）
-    vhost.try_emplace("localhost:" + listenPort, resHost);
-    vhost.try_emplace("127.0.0.1:" + listenPort, resHost);
-    // 设置为 htdocs 服务的资源主机，以提供 vhost 别名
-    for (auto const& vh : vhost_aliases){
-        if (vh.length() >= 122){
-            std::cout << "vhost " << vh << "too long, skipping" << std::endl;
+    std::cout << "Disk path: " << diskpath << " (" << storage << ")" << std::endl;
+    // 第一代虚拟主机：为 diskpath 服务的资源主机，始终为 localhost/127.0.0.1 和 vhost 别名提供服务
+    // 该资源主机也是默认主机，除非用 setDefaultVhost() 另行指定
+    gen = std::make_shared<VhostGeneration>();
+    gen->addPrimary(diskpath, storage, vhost_aliases, nullptr);
+
+    // 信号自管道，信号处理函数只写一个命令字节
+    if (pipe(signalPipe) == 0){
+        for (int32_t fd : signalPipe){
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    // 磁盘 I/O 线程池（start() 之前的缓存预热也会用到）
+    ioPool = std::make_unique<IOThreadPool>(ioThreads);
+
+    memController = std::make_unique<MemoryController>();
+    applyCacheBudget();
+
+    registerBuiltinRoutes();
+    renderOverloadResponse();
+}
+
+// 应用准入控制的配置（启动时和重新加载后）
+// max_connections=<N> 全局连接数上限，max_connections.<host>=<N> 虚拟主机的连接数上限，
+// overload_target_ms=<N> 排队延迟的目标，rate_limit=<N> 与 rate_limit_burst=<N> 每个 IP 的请求速率
+// @param cfg 配置
+void HTTPServer::applyAdmissionConfig(ServerConfig const& cfg){
+    maxConnections = cfg.getInt("max_connections", 0);
+    if (rateLimiter != nullptr)
+        rateLimiter->setRate(cfg.getInt("rate_limit", 0), cfg.getInt("rate_limit_burst", 0));
+    else if (cfg.getInt("rate_limit", 0) > 0)
+        std::cout << "enabling rate_limit requires a restart" << std::endl;
+    admission.setTarget(cfg.getInt("overload_target_ms", ADMISSION_TARGET_MS));
+    for (auto const& host : gen->hostList)
+        host->setConnectionLimit(0);
+    for (auto const& [k, v] : cfg.values){
+        if (!k.starts_with("max_connections."))
+            continue;
+        auto resHost = gen->hostTable.find(k.substr(16));
+        if (resHost == nullptr){
+            std::cout << k << ": unknown vhost" << std::endl;
+            continue;
+        }
+        resHost->setConnectionLimit(strtoul(v.c_str(), nullptr, 10));
+    }
+}
+
+// 设置内容缓存总预算的上下限
+// 启动前重新创建内存控制器；运行中（重新加载配置时）只修改上下限，保留当前预算和计数
+// @param minBytes 内存压力再大也保留的预算
+// @param maxBytes 空闲时最多增长到的预算
+void HTTPServer::setCacheLimits(uint64_t minBytes, uint64_t maxBytes){
+    if (memController == nullptr || !canRun)
+        memController = std::make_unique<MemoryController>(minBytes, maxBytes);
+    else if (!memController->setLimits(minBytes, maxBytes))
+        return;
+    applyCacheBudget();
+}
+
+// 把内存控制器给出的总预算平均分配给使用磁盘后端的资源主机
+// 内存和资源包后端不使用内容缓存
+void HTTPServer::applyCacheBudget(){
+    if (memController == nullptr)
+        return;
+    uint32_t n = 0;
+    for (auto const& host : gen->hostList){
+        if (!host->isNonBlocking())
+            ++n;
+    }
+    if (n == 0)
+        return;
+    uint64_t share = memController->getBudget() / n;
+    for (auto const& host : gen->hostList){
+        if (!host->isNonBlocking())
+            host->setCacheBudget(share);
+    }
+}
+
+// 导出运行指标（Prometheus 文本格式）
+std::string HTTPServer::getMetrics() const {
+    std::string ret;
+    if (memController != nullptr)
+        ret += memController->getMetrics();
+    if (cpuPool != nullptr)
+        ret += cpuPool->getMetrics();
+    ret += FramePool::getMetrics();
+    ret += "vhost_generation " + std::to_string(gen->id) + "\n";
+    ret += admission.getMetrics();
+    if (rateLimiter != nullptr)
+        ret += rateLimiter->getMetrics();
+    ret += "io_deferred_tasks " + std::to_string(deferredIO.size()) + "\n";
+    ret += "server_connections " + std::to_string(clientMap.size()) + "\n";
+    ret += "client_read_paused_total " + std::to_string(readPauses) + "\n";
+    ret += "write_sent_bytes_total{class=\"small\"} " + std::to_string(writeSmallBytes) + "\n";
+    ret += "write_sent_bytes_total{class=\"bulk\"} " + std::to_string(writeBulkBytes) + "\n";
+    ret += "write_budget_exhausted_total " + std::to_string(writeBudgetExhausted) + "\n";
+    ret += "write_scheduled_clients " + std::to_string(writeSmall.size() + writeBulk.size()) + "\n";
+    ret += "tcp_info_samples_total " + std::to_string(tcpSamples) + "\n";
+    ret += "tcp_sndbuf_grown_total " + std::to_string(sndBufGrown) + "\n";
+    // prefork：所有工作进程的计数器，任一工作进程都能报告整体情况
+    if (statsSegment != nullptr)
+        ret += statsSegment->getMetrics();
+    auto const& hostList = gen->hostList;
+    for (size_t i = 0; i < hostList.size(); ++i){
+        ret += "resourcehost_cache_bytes{host=\"" + std::to_string(i) + "\"} " + std::to_string(hostList[i]->getCacheBytes()) + "\n";
+        ret += "resourcehost_cache_budget_bytes{host=\"" + std::to_string(i) + "\"} " + std::to_string(hostList[i]->getCacheBudget()) + "\n";
+        ret += hostList[i]->getArenaMetrics("host=\"" + std::to_string(i) + "\"");
+        ret += "resourcehost_connections{host=\"" + std::to_string(i) + "\"} " + std::to_string(hostList[i]->getConnections()) + "\n";
+    }
+    return ret;
+}
+
+// 添加虚拟主机
+// 为主机名创建独立的资源主机（docroot 和存储后端），须在 start() 之前调用
+// @param host 主机名（不含端口）
+// @param storage 存储后端："disk"、"memory" 或 "pack"
+// @param path 后端的路径（目录或 .pack 文件）
+void HTTPServer::addVhost(std::string const& host, std::string const& storage, std::string const& path){
+    if (gen->addVhost(host, storage, path, nullptr))
+        applyCacheBudget();
+}
+
+// 指定默认虚拟主机
+// HTTP/1.0 请求（可能没有 Host 头）和 Host 不匹配任何虚拟主机的请求由它响应；
+// 未指定时 HTTP/1.0 请求由 diskpath 的资源主机响应，HTTP/1.1 的未知主机返回 400
+// @param host 已添加的主机名
+// @return 主机不存在时返回 false
+bool HTTPServer::setDefaultVhost(std::string const& host){
+    if (!gen->hostTable.setDefault(host)){
+        std::cout << "default_vhost " << host << " is not a configured vhost" << std::endl;
+        return false;
+    }
+    std::cout << "Default vhost: " << host << std::endl;
+    return true;
+}
+
+// 缓存预热
+// 在 start() 开始接受连接之前，并行地把资源加载进各资源主机的内容缓存
+// 先对所有文件发出预读提示，让内核批量读入页缓存，再由 I/O 线程池并行加载
+// @param entries (主机名, URI) 列表，主机名为空时使用默认资源主机
+void HTTPServer::warmUp(std::vector<std::pair<std::string, std::string>> const& entries){
+    if (entries.empty() || gen->hostList.empty() || ioPool == nullptr)
+        return;
+    auto startTime = std::chrono::steady_clock::now();
+
+    // 解析主机，跳过内存/资源包后端（它们本来就不访问磁盘）
+    std::vector<std::pair<std::shared_ptr<ResourceHost>, std::string>> jobs;
+    for (auto const& [host, uri] : entries){
+        std::shared_ptr<ResourceHost> resHost = gen->hostList[0];
+        if (!host.empty()){
+            resHost = gen->hostTable.find(host);
+            if (resHost == nullptr)
+                continue;
+        }
+        if (resHost->isNonBlocking())
             continue;
+        resHost->prefetch(uri);
+        jobs.emplace_back(resHost, uri);
+    }
+
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+    uint32_t loaded = 0;
+    uint64_t bytes = 0;
+    struct pollfd pfd = {ioPool->getWakeFd(), POLLIN, 0};
+
+    for (size_t i = 0; i < jobs.size() || completed < submitted; ){
+        if (i < jobs.size()){
+            auto [resHost, uri] = jobs[i];
+            auto res = std::make_shared<std::shared_ptr<Resource>>();
+            IOTask task;
+            task.work = [resHost, uri, res]{
+                *res = resHost->getResource(uri);
+            };
+            task.done = [resHost, uri, res, &completed, &loaded, &bytes]{
+                ++completed;
+                if (*res == nullptr)
+                    return;
+                ++loaded;
+                bytes += (*res)->getSize();
+                resHost->cacheResource(uri, *res);
+            };
+            if (ioPool->submit(task)){
+                ++submitted;
+                ++i;
+                continue;
+            }
         }
-        std::cout << "vhost: " << vh << std::endl;
-        vhost.try_emplace(vh + ":" + listenPort, resHost);
-    } 
+        // 队列已满或所有任务都已提交：等待完成通知
+        poll(&pfd, 1, 100);
+        ioPool->runCompletions();
+    }
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Warm-up loaded " << loaded << "/" << entries.size() << " resources (" << bytes
+              << " bytes) in " << ms << " ms" << std::endl;
 }
 
 // server 析构函数
 HTTPServer::~HTTPServer(){
-    hostList.clear();
-    vhosts.clear();
+    gen.reset();
+    for (int32_t fd : signalPipe){
+        if (fd != -1)
+            close(fd);
+    }
 }
 
-// start server
-// 通过请求socket handle、binding和进入监听状态来初始化服务器套接字
-// 如果初始化成功，则返回 True。否则为 False
-bool HTTPServer::start(){
-    canRun = true;
+// 创建监听套接字
+// 创建套接字、绑定端口、按需降权并进入监听状态
+// @return 任何一步失败时返回 false
+bool HTTPServer::bindListenSocket(){
     // 创建一个监听套接字的handle
     listtenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (listenSocket == INVALID_SOCKET){
@@ -97,12 +300,38 @@ bool HTTPServer::start(){
         }
         std::cout << "Successfully dropped uid to " << dropUid << " and gid to " << dropGid << std::endl;
     }
+    // 套接字选项（已接受的连接继承它们）
+    socketProfile.applyListener(listenSocket);
     // 监听 将套接字置于监听状态，随时准备接受连接
-    // 接受队列中积压的操作系统最大连接数
-    if (listen(listenSocket, SOMAXCONN) != 0){
+    // 接受队列中积压的连接数，默认为操作系统的最大值
+    if (listen(listenSocket, socketProfile.backlog) != 0){
         std::cout << "Failed to put the socket in a listening state" << std::endl;
         return false;
     }
+    return true;
+}
+
+// start server
+// 通过请求socket handle、binding和进入监听状态来初始化服务器套接字
+// 如果初始化成功，则返回 True。否则为 False
+bool HTTPServer::start(){
+    canRun = true;
+    // 以升级方式启动：监听套接字由旧进程传来，已经绑定并处于监听状态，uid/gid 也与旧进程相同
+    int32_t channel = Upgrade::takeInheritedChannel();
+    if (channel != -1){
+        listenSocket = Upgrade::recvFd(channel);
+        if (listenSocket == INVALID_SOCKET){
+            std::cout << "Could not receive the listening socket from the old process" << std::endl;
+            close(channel);
+            channel = -1;
+        } else {
+            fcntl(listenSocket, F_SETFL, O_NONBLOCK);
+            socketProfile.applyListener(listenSocket);
+            std::cout << "Inherited listening socket from the old process" << std::endl;
+        }
+    }
+    if (listenSocket == INVALID_SOCKET && !bindListenSocket())
+        return false;
     // setup kqueue
     kqfd = kqueue();
     if (kqfd == -1){
@@ -111,9 +340,35 @@ bool HTTPServer::start(){
     }
     // 让 kqueue 监视监听套接字
     updateEvent(listenSocket, EVFILT_READ, EV_ADD, 0, 0, NULL);
+    // 让 kqueue 监视 I/O 线程池的完成通知（stop() 之后重新启动时需要重建线程池）
+    if (ioPool == nullptr)
+        ioPool = std::make_unique<IOThreadPool>(ioThreads);
+    updateEvent(ioPool->getWakeFd(), EVFILT_READ, EV_ADD, 0, 0, NULL);
+    // CPU 线程池的完成通知
+    cpuPool = std::make_unique<CpuTaskPool>(cpuThreads);
+    updateEvent(cpuPool->getWakeFd(), EVFILT_READ, EV_ADD, 0, 0, NULL);
+
+    // 让 kqueue 监视各资源主机的目录变更通知
+    for (auto const& host : gen->hostList){
+        if (host->getNotifyFd() != -1)
+            updateEvent(host->getNotifyFd(), EVFILT_READ, EV_ADD, 0, 0, NULL);
+    }
+    // 信号自管道（SIGHUP 重新加载、SIGUSR2 升级）
+    if (signalPipe[0] != -1)
+        updateEvent(signalPipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+    // prefork：其他工作进程迁移过来的连接
+    if (workerStats != nullptr && workerStats->inbox != -1)
+        updateEvent(workerStats->inbox, EVFILT_READ, EV_ADD, 0, 0, NULL);
 
     canRun = true;
     std::cout << "Server ready. Listening on port " << listenPort << "..." <<std::endl;
+    // 通知旧进程：新进程已经开始接受连接，旧进程可以停止接受并排空
+    if (channel != -1){
+        char ack = UPGRADE_ACK;
+        if (write(channel, &ack, 1) != 1)
+            std::cout << "Could not acknowledge the upgrade to the old process" << std::endl;
+        close(channel);
+    }
     return true;
 }
 
@@ -121,20 +376,39 @@ bool HTTPServer::start(){
 // 断开所有客户端连接，清理在 start() 中创建的所有服务器资源
 void HTTPServer::stop(){
     canRun = false;
-    if (listenSocket != INVALID_SOCKET){
-        // 关闭所有打开的连接，并从内存中删除客户端
-        for (auto& [clfd, cl] : clientMap)
-            disconnectClient(cl, false);
-        // clear map
-        clientMap.clear();
+    // 关闭所有打开的连接，并从内存中删除客户端（升级排空时监听套接字已经交出）
+    for (auto& [clfd, cl] : clientMap)
+        disconnectClient(cl, false);
+    // clear map
+    clientMap.clear();
+    writeSmall.clear();
+    writeBulk.clear();
 
+    if (listenSocket != INVALID_SOCKET){
         // 从 kqueue 中移除监听套接字
         updateEvent(listenSocket, EVFILT_READ, EV_DELETE, 0, 0, NULL);
-        // 关闭监听套接字并将其释放给操作系统
-        shutdown(listenSocket, SHUT_RDWR);
+        // 关闭监听套接字并将其释放给操作系统（与其他工作进程共享时不能 shutdown，否则它们也无法接受连接）
+        if (!sharedListener)
+            shutdown(listenSocket, SHUT_RDWR);
         close(listenSocket);
         listenSocket = INVALID_SOCKET;
     }
+    // 等待 I/O 线程退出，尚未完成和暂存的加载被丢弃
+    ioPool.reset();
+    deferredIO.clear();
+    cpuPool.reset();
+    // 尚未完成的协程随服务器停止一起销毁，帧归还给 FramePool：
+    // 等待 I/O 的协程已在断开连接时被调度，等待加载的协程在放弃加载后被调度，其余的挂在定时器上
+    for (auto const& host : gen->hostList)
+        host->cancelLoads();
+    while (!timers.empty()){
+        readyCoroutines.push_back(timers.top().handle);
+        timers.pop();
+    }
+    for (auto h : readyCoroutines)
+        Task::destroySuspended(h);
+    readyCoroutines.clear();
+
     if (kqfd != -1) {
         close(kqfd);
         kqfd = -1;
@@ -159,8 +433,45 @@ void HTTPServer::process(){
     while (canRun){
         //获取在 evList 中触发读取事件的已更改套接字描述符列表
         // 在标头中设置超时
-        nev = kevent(kqfd, NULL, 0, evList, QUEUE_SIZE, &kqTimeOut);
+        // 有定时器时不阻塞超过最近的到期时间
+        struct timespec timeout = nextTimeout();
+        nev = kevent(kqfd, NULL, 0, evList, QUEUE_SIZE, &timeout);
+        auto wakeTime = std::chrono::steady_clock::now();
+
+        // 每秒根据内存压力调整一次缓存预算，并整理一次缓存 arena
+        // 这些维护工作不计入准入控制的延迟（只计入工作进程的忙碌时间）
+        time_t now = time(nullptr);
+        if (memController != nullptr && memController->tick(now))
+            applyCacheBudget();
+        if (now != lastCompact){
+            lastCompact = now;
+            for (auto const& h : gen->hostList)
+                h->compactCache(ARENA_COMPACT_BYTES);
+
+            // prefork：与其他工作进程平衡连接数
+            if (workerStats != nullptr && !draining)
+                rebalance(now);
+
+            // 升级后排空：关闭空闲连接，全部结束或超时后退出
+            if (draining){
+                closeIdleClients();
+                if (clientMap.empty() || now >= drainDeadline){
+                    std::cout << "Drain finished with " << clientMap.size() << " connections left, exiting" << std::endl;
+                    canRun = false;
+                    continue;
+                }
+            }
+        }
+
+        // 请求的排队时间从这里开始计算
+        auto busyStart = std::chrono::steady_clock::now();
+        loopStart = busyStart;
+
         if (nev <= 0){
+            runTimers();
+            resumeReady();
+            // 没有事件的一轮说明没有排队，让准入控制退出高于目标的状态
+            admission.observe(DELAY_LOOP_LAG, {}, std::chrono::steady_clock::now());
             continue;
         }
         // 只循环查看 evList 数组中发生变化的套接字
@@ -171,6 +482,43 @@ void HTTPServer::process(){
                 continue;
             }
 
+            // I/O 线程池完成了加载，在事件循环线程上发送响应
+            if (ioPool != nullptr && evList[i].ident == (uint32_t)ioPool->getWakeFd()){
+                ioPool->runCompletions();
+                flushDeferredIO();
+                continue;
+            }
+
+            // CPU 线程池构造完了响应，放入客户端的发送队列
+            if (cpuPool != nullptr && evList[i].ident == (uint32_t)cpuPool->getWakeFd()){
+                cpuPool->runCompletions();
+                continue;
+            }
+
+            // 信号处理函数写入了命令字节
+            if (evList[i].ident == (uint32_t)signalPipe[0]){
+                processSignals();
+                continue;
+            }
+
+            // 新进程的升级确认
+            if (evList[i].ident == (uint32_t)upgradeChannel){
+                finishUpgrade();
+                continue;
+            }
+
+            // 其他工作进程迁移过来的空闲连接
+            if (workerStats != nullptr && evList[i].ident == (uint32_t)workerStats->inbox){
+                adoptClients();
+                continue;
+            }
+
+            // docroot 目录变更通知，使负缓存失效
+            if (auto host = getHostForNotifyFd(evList[i].ident); host != nullptr){
+                host->processNotifications();
+                continue;
+            }
+
             // 客户端描述符触发事件
             auto cl = getClient(evList[i].ident);  // 标识包含客户端套接字描述符
             if (cl == nullptr){
@@ -184,52 +532,492 @@ void HTTPServer::process(){
             }
 
             // 客户端希望断开连接
+            // 读取方向的 EOF（半关闭）且还有响应没有发出时，先停止读取，发送完后由恢复读取时再次触发
+            if ((evList[i].flags & EV_EOF) && evList[i].filter == EVFILT_READ && !cl->isWaitingRead()
+                && (cl->sendQueueSize() > 0 || cl->isParked())){
+                updateEvent(evList[i].ident, EVFILT_READ, EV_DISABLE, 0, 0, NULL);
+                cl->setReadPaused(true);
+                continue;
+            }
             if (evList[i].flags & EV_EOF){
                 disconnectClient(cl, true);
                 continue;
             }
 
             if (evList[i].filter == EVFILT_READ){
+                // 协程在等待该客户端的数据
+                if (cl->isWaitingRead()){
+                    updateEvent(evList[i].ident, EVFILT_READ, EV_DISABLE, 0, 0, NULL);
+                    cl->takeIoWaiter()(true);
+                    continue;
+                }
                 // 读取客户端请求
                 readClient(cl, evList[i].data);
-
-                // 让 kqueue 禁用 “读取 ”事件的跟踪，启用 “写入 ”事件的跟踪
-                updateEvent(evList[i].ident, EVFILT_READ, EV_DISABLE, 0, 0, NULL);
-                updateEvent(evList[i].ident, EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
-            } else if(evList[i].filter == EVFILT_WRITE){
-                if (!writeClient(cl, evList[i].data)){
-                    updateEvent(evList[i].ident, EVFILT_READ, EV_ENABLE, 0, 0, NULL);
-                    updateEvent(evList[i].ident, EVFILT_WRITE, EV_DISABLE, 0, 0, NULL);
+                if (!clientMap.contains(evList[i].ident))
+                    continue;
+
+                // 响应发送期间可以继续读取后续的请求（按顺序排在发送队列后面），
+                // 挂起（等待异步加载，保证响应顺序）或发送队列超过高水位时暂停读取
+                if (cl->isParked() || cl->getQueuedBytes() > SEND_QUEUE_HIGH_WATER){
+                    updateEvent(evList[i].ident, EVFILT_READ, EV_DISABLE, 0, 0, NULL);
+                    cl->setReadPaused(true);
+                    if (!cl->isParked())
+                        ++readPauses;
                 }
+                // 让 kqueue 启用 “写入 ”事件的跟踪
+                if (cl->sendQueueSize() > 0)
+                    updateEvent(evList[i].ident, EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+            } else if(evList[i].filter == EVFILT_WRITE){
+                // 先登记，所有事件处理完后按份额发送
+                scheduleWrite(cl, evList[i].data);
             }
         }
+
+        runWrites();
+        runTimers();
+        resumeReady();
+        // 这一轮的处理时间就是其间到达的事件要等待的时间
+        auto busyEnd = std::chrono::steady_clock::now();
+        admission.observe(DELAY_LOOP_LAG, busyEnd - busyStart, busyEnd);
+        if (workerStats != nullptr){
+            auto busy = std::chrono::duration_cast<std::chrono::microseconds>(busyEnd - wakeTime);
+            workerStats->busyMicros.fetch_add(busy.count(), std::memory_order_relaxed);
+        }
+    }
+}
+
+// 计算 kevent 的超时：默认的最长阻塞时间，或最近的定时器到期前的时间
+struct timespec HTTPServer::nextTimeout() const {
+    // 还有顺延到下一轮的写操作，不阻塞
+    if (!writeSmall.empty() || !writeBulk.empty())
+        return {0, 0};
+    if (timers.empty())
+        return kqTimeout;
+    auto wait = timers.top().deadline - std::chrono::steady_clock::now();
+    if (wait <= std::chrono::nanoseconds(0))
+        return {0, 0};
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+    if (ns >= kqTimeout.tv_sec * 1000000000LL + kqTimeout.tv_nsec)
+        return kqTimeout;
+    return {(time_t)(ns / 1000000000), (long)(ns % 1000000000)};
+}
+
+// 把到期的定时器对应的协程放入就绪队列
+void HTTPServer::runTimers(){
+    auto now = std::chrono::steady_clock::now();
+    while (!timers.empty() && timers.top().deadline <= now){
+        schedule(timers.top().handle);
+        timers.pop();
+    }
+}
+
+// 恢复所有就绪的协程
+// 协程恢复后可能再次挂起并把其他协程放入队列，这里一直处理到队列为空
+void HTTPServer::resumeReady(){
+    while (!readyCoroutines.empty()){
+        auto h = readyCoroutines.front();
+        readyCoroutines.pop_front();
+        h.resume();
+    }
+}
+
+// 注册路由，须在 start() 之前调用
+// 按主机注册的路由会被记住，重新加载配置后安装到新的一代
+// @param host 虚拟主机名（不含端口），为空时注册到所有主机共用的路由表
+// @param methods 方法掩码（methodBit(GET) | methodBit(HEAD) 等）
+// @param pattern 路径模式（静态文本、:参数、*通配后缀）
+// @param handler 处理函数，参数只在调用期间有效
+// @return 主机不存在或与已有路由冲突时返回 false
+bool HTTPServer::addRoute(std::string const& host, uint32_t methods, std::string const& pattern, RouteHandler handler){
+    if (host.empty())
+        return globalRouter.add(methods, pattern, std::move(handler));
+
+    HostRoute route{host, methods, pattern, std::move(handler)};
+    if (!installHostRoute(*gen, route))
+        return false;
+    hostRoutes.push_back(std::move(route));
+    return true;
+}
+
+// 把按主机注册的路由安装到某一代的路由表
+// @param g 虚拟主机的一代
+// @param route 路由
+// @return 主机不存在或与已有路由冲突时返回 false
+bool HTTPServer::installHostRoute(VhostGeneration& g, HostRoute const& route){
+    auto resHost = g.hostTable.find(route.host);
+    if (resHost == nullptr){
+        std::cout << "Route " << route.pattern << ": unknown vhost " << route.host << std::endl;
+        return false;
+    }
+    auto& router = g.hostRouters[std::string(HostTable::bareHost(route.host))];
+    if (router == nullptr)
+        router = std::make_unique<Router>();
+    return router->add(route.methods, route.pattern, route.handler);
+}
+
+// 请求重新加载配置（SIGHUP 处理函数中调用）
+// 只写自管道，是异步信号安全的；实际的加载在事件循环中进行
+void HTTPServer::notifyReload(){
+    if (signalPipe[1] != -1){
+        char c = SIGNAL_RELOAD;
+        [[maybe_unused]] auto n = write(signalPipe[1], &c, 1);
+    }
+}
+
+// 请求不停机升级（SIGUSR2 处理函数中调用），同 notifyReload()
+void HTTPServer::notifyUpgrade(){
+    if (signalPipe[1] != -1){
+        char c = SIGNAL_UPGRADE;
+        [[maybe_unused]] auto n = write(signalPipe[1], &c, 1);
+    }
+}
+
+// 处理信号自管道中的命令，同一命令多次到达只执行一次
+void HTTPServer::processSignals(){
+    bool doReload = false;
+    bool doUpgrade = false;
+    char buf[64];
+    ssize_t n;
+    while ((n = read(signalPipe[0], buf, sizeof(buf))) > 0){
+        for (ssize_t i = 0; i < n; ++i){
+            doReload |= buf[i] == SIGNAL_RELOAD;
+            doUpgrade |= buf[i] == SIGNAL_UPGRADE;
+        }
+    }
+    if (doReload)
+        reload();
+    if (doUpgrade)
+        upgrade();
+}
+
+// 开始不停机升级
+// 启动新的二进制文件并把监听套接字交给它；在它确认开始接受连接之前，本进程照常服务
+void HTTPServer::upgrade(){
+    if (upgradeChannel != -1 || draining){
+        std::cout << "Upgrade already in progress" << std::endl;
+        return;
+    }
+    if (execArgs.empty() || listenSocket == INVALID_SOCKET){
+        std::cout << "Upgrade requested but the server cannot re-exec itself" << std::endl;
+        return;
+    }
+    upgradePid = Upgrade::spawn(execArgs, listenSocket, upgradeChannel);
+    if (upgradePid == -1)
+        return;
+    std::cout << "Upgrading: started " << execArgs[0] << " as pid " << upgradePid << std::endl;
+    updateEvent(upgradeChannel, EVFILT_READ, EV_ADD, 0, 0, NULL);
+}
+
+// 处理新进程的确认
+// 收到确认后停止接受连接并开始排空；新进程在确认之前退出则放弃升级，本进程继续服务
+void HTTPServer::finishUpgrade(){
+    char ack = 0;
+    bool ok = read(upgradeChannel, &ack, 1) == 1 && ack == UPGRADE_ACK;
+    updateEvent(upgradeChannel, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    close(upgradeChannel);
+    upgradeChannel = -1;
+    if (!ok){
+        std::cout << "Upgrade failed: pid " << upgradePid << " exited before accepting connections" << std::endl;
+        waitpid(upgradePid, nullptr, WNOHANG);
+        upgradePid = -1;
+        return;
+    }
+
+    // 新进程持有同一个监听套接字，这里只关闭本进程的描述符（不能 shutdown，否则新进程也无法接受连接）
+    std::cout << "pid " << upgradePid << " is accepting connections, draining " << clientMap.size() << " clients" << std::endl;
+    updateEvent(listenSocket, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    close(listenSocket);
+    listenSocket = INVALID_SOCKET;
+    draining = true;
+    drainDeadline = time(nullptr) + UPGRADE_DRAIN_SECONDS;
+    closeIdleClients();
+}
+
+// 关闭空闲的客户端连接（排空期间）
+// 正在加载、构造或发送响应的连接保留，它们的响应带 Connection: close，发送完后断开
+void HTTPServer::closeIdleClients(){
+    std::vector<std::shared_ptr<Client>> idle;
+    for (auto const& [clfd, cl] : clientMap){
+        if (cl->isIdle())
+            idle.push_back(cl);
+    }
+    for (auto const& cl : idle)
+        disconnectClient(cl);
+}
+
+// 重新加载配置
+// 在 I/O 线程上解析配置文件并构建新的一代虚拟主机（内存后端需要读取整个 docroot），
+// 完成后回到事件循环线程整体替换。后端未变的资源主机被沿用，缓存不受影响；
+// 配置无效时保留当前的一代
+void HTTPServer::reload(){
+    if (reloading){
+        reloadAgain = true;
+        return;
+    }
+    if (configPath.empty()){
+        std::cout << "Reload requested but no config path is set" << std::endl;
+        return;
+    }
+    std::cout << "Reloading " << configPath << "..." << std::endl;
+    reloading = true;
+
+    auto cfg = std::make_shared<ServerConfig>();
+    auto next = std::make_shared<std::shared_ptr<VhostGeneration>>();
+    IOTask task;
+    task.work = [path = configPath, cfg, next, previous = gen]{
+        if (cfg->load(path))
+            *next = VhostGeneration::build(*cfg, previous.get());
+    };
+    task.done = [this, cfg, next]{
+        reloading = false;
+        if (*next == nullptr)
+            std::cout << "Reload failed, keeping vhost generation " << gen->id << std::endl;
+        else
+            swapGeneration(*next, *cfg);
+        if (reloadAgain){
+            reloadAgain = false;
+            reload();
+        }
+    };
+    submitIO(std::move(task));
+}
+
+// 提交 I/O 任务
+// 线程池队列已满时暂存，等有任务完成后重新提交，不在事件循环线程上执行阻塞的 work；
+// 已有暂存的任务时也排在它们后面，保持提交顺序
+// @param task 任务
+void HTTPServer::submitIO(IOTask task){
+    if (deferredIO.empty() && ioPool != nullptr && ioPool->submit(task))
+        return;
+    deferredIO.push_back(std::move(task));
+}
+
+// 把暂存的任务重新提交到线程池，直到队列再次满（完成通知到达后调用）
+void HTTPServer::flushDeferredIO(){
+    while (!deferredIO.empty() && ioPool != nullptr && ioPool->submit(deferredIO.front()))
+        deferredIO.pop_front();
+}
+
+// 用新的一代替换当前的一代（事件循环线程）
+// 替换发生在两个事件之间，之后的请求都看到新的一代；已经开始的加载和协程持有旧资源主机的
+// shared_ptr，在旧的一代上完成，最后一个引用释放时旧资源主机才被销毁。
+// 发送队列只持有资源对象，正文所在的内存（arena、资源包的映射）由资源对象自己持有
+// @param next 新的一代
+// @param cfg 新的配置
+void HTTPServer::swapGeneration(std::shared_ptr<VhostGeneration> next, ServerConfig const& cfg){
+    for (auto const& route : hostRoutes)
+        installHostRoute(*next, route);
+
+    // 只在一代中出现的资源主机：调整 kqueue 对目录变更通知的监视
+    auto contains = [](VhostGeneration const& g, std::shared_ptr<ResourceHost> const& host){
+        return std::find(g.hostList.begin(), g.hostList.end(), host) != g.hostList.end();
+    };
+    if (kqfd != -1){
+        for (auto const& host : gen->hostList){
+            if (host->getNotifyFd() != -1 && !contains(*next, host))
+                updateEvent(host->getNotifyFd(), EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        }
+        for (auto const& host : next->hostList){
+            if (host->getNotifyFd() != -1 && !contains(*gen, host))
+                updateEvent(host->getNotifyFd(), EVFILT_READ, EV_ADD, 0, 0, NULL);
+        }
+    }
+
+    // 监听端口、降权和线程数只在启动时生效
+    if (cfg.port != listenPort || cfg.getInt("io_threads", ioThreads) != ioThreads ||
+        cfg.getInt("cpu_threads", cpuThreads) != cpuThreads || cfg.getInt("drop_uid", dropUid) != dropUid)
+        std::cout << "port, drop_uid/drop_gid, io_threads and cpu_threads changes require a restart" << std::endl;
+
+    gen = std::move(next);
+    applyAdmissionConfig(cfg);
+    applyEndpointConfig(cfg);
+    setWritePriority(cfg.getInt("write_priority_kb", WRITE_PRIORITY_BYTES >> 10) << 10);
+    if (cfg.contains("cache_min_mb") || cfg.contains("cache_max_mb")){
+        uint64_t minMb = cfg.getInt("cache_min_mb", MEMCTL_MIN_BUDGET >> 20);
+        uint64_t maxMb = cfg.getInt("cache_max_mb", MEMCTL_MAX_BUDGET >> 20);
+        setCacheLimits(minMb << 20, maxMb << 20);
+    }
+    applyCacheBudget();
+    std::cout << "Loaded vhost generation " << gen->id << ": " << gen->hostList.size() << " resource hosts ("
+              << gen->reused << " reused)" << std::endl;
+}
+
+// 注册协程处理函数，须在 start() 之前调用
+// 匹配的请求启动一个协程处理，处理期间客户端被挂起
+// @param host 虚拟主机名，为空时对所有主机生效
+// @param methods 方法掩码
+// @param pattern 路径模式
+// @param handler 处理函数，返回处理请求的协程
+// @return 同 addRoute()
+bool HTTPServer::addAsyncHandler(std::string const& host, uint32_t methods, std::string const& pattern, AsyncHandler handler){
+    return addRoute(host, methods, pattern, [this, handler](std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, RouteParams const&){
+        cl->setParked(true);
+        runAsyncHandler(handler, cl, req).detach();
+    });
+}
+
+// 注册默认路由
+// 没有更具体的路由时，GET/HEAD 从资源主机提供文件，OPTIONS 和 TRACE 由各自的处理函数响应；
+// /health 和 /metrics 不在这里注册，由 applyEndpointConfig() 按配置安装到指定的主机
+void HTTPServer::registerBuiltinRoutes(){
+    uint32_t getHead = methodBit(Method(GET)) | methodBit(Method(HEAD));
+    globalRouter.add(getHead, "*", [this](std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, RouteParams const&){
+        handleGet(cl, req.get());
+    });
+    globalRouter.add(methodBit(Method(OPTIONS)), "*", [this](std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, RouteParams const&){
+        handleOptions(cl, req.get());
+    });
+    globalRouter.add(methodBit(Method(TRACE)), "*", [this](std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, RouteParams const&){
+        handleTrace(cl, req.get());
+    });
+}
+
+// 安装内置的健康检查和指标端点（启动时和重新加载后）
+// 默认不开放；health_endpoint=<host>/<path>、metrics_endpoint=<host>/<path> 只在指定的虚拟主机上响应，
+// 例如 metrics_endpoint=admin.internal/metrics。端点直接在进程内响应，不访问文件系统
+// @param cfg 配置
+void HTTPServer::applyEndpointConfig(ServerConfig const& cfg){
+    uint32_t getHead = methodBit(Method(GET)) | methodBit(Method(HEAD));
+    auto install = [&](char const* key, RouteHandler handler){
+        std::string spec = cfg.get(key);
+        if (spec.empty())
+            return;
+        size_t slash = spec.find('/');
+        if (slash == 0 || slash == std::string::npos){
+            std::cout << key << "=" << spec << ": expected <host>/<path>" << std::endl;
+            return;
+        }
+        installHostRoute(*gen, HostRoute{spec.substr(0, slash), getHead, spec.substr(slash), std::move(handler)});
+    };
+    install("health_endpoint", [this](std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, RouteParams const&){
+        handleHealth(cl, req.get());
+    });
+    install("metrics_endpoint", [this](std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, RouteParams const&){
+        handleMetrics(cl, req.get());
+    });
+}
+
+// 执行协程处理函数
+// 处理期间客户端被挂起（不读取新请求），处理结束后恢复读取
+// @param handler 处理函数
+// @param cl 发出请求的客户端
+// @param req 请求，在协程结束前保持有效
+Task HTTPServer::runAsyncHandler(AsyncHandler handler, std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req){
+    co_await handler(*this, cl, req);
+
+    // 处理函数可能已经断开了连接
+    if (auto it = clientMap.find(cl->getSocket()); it == clientMap.end() || it->second != cl)
+        co_return;
+    cl->setParked(false);
+    // 发送队列清空后由写事件重新开始读取
+    updateEvent(cl->getSocket(), EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+}
+
+// 内存、资源包后端和内容缓存命中时不需要挂起
+bool HTTPServer::LoadAwaiter::await_ready(){
+    if (host->isNonBlocking()){
+        result = host->lookupResource(uri, false);
+        return true;
     }
+    result = server->lookupCached(host, uri);
+    // 已确认不存在的 URI 也不需要挂起，结果为 NULL
+    return result != nullptr || host->isMissing(uri);
+}
+
+void HTTPServer::LoadAwaiter::await_suspend(std::coroutine_handle<> h){
+    server->startLoad(host, uri, [this, h](std::shared_ptr<Resource> r){
+        result = std::move(r);
+        server->schedule(h);
+    });
+}
+
+void HTTPServer::SleepAwaiter::await_suspend(std::coroutine_handle<> h){
+    server->timers.push(Timer{std::chrono::steady_clock::now() + delay, h});
+}
+
+void HTTPServer::SendAwaiter::await_suspend(std::coroutine_handle<> h){
+    // 客户端已经断开
+    if (!server->clientMap.contains(cl->getSocket())){
+        ok = false;
+        server->schedule(h);
+        return;
+    }
+    server->sendResponse(cl, std::move(resp), disconnect);
+    cl->setIoWaiter([this, h](bool connected){
+        ok = connected;
+        server->schedule(h);
+    }, false);
+    server->updateEvent(cl->getSocket(), EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+}
+
+void HTTPServer::RecvAwaiter::await_suspend(std::coroutine_handle<> h){
+    if (!server->clientMap.contains(cl->getSocket())){
+        server->schedule(h);
+        return;
+    }
+    cl->setIoWaiter([this, h](bool connected){
+        if (connected){
+            data.resize(maxLen);
+            ssize_t n = ::recv(cl->getSocket(), data.data(), maxLen, 0);
+            data.resize(n > 0 ? n : 0);
+        }
+        server->schedule(h);
+    }, true);
+    server->updateEvent(cl->getSocket(), EVFILT_READ, EV_ENABLE, 0, 0, NULL);
 }
 
 //  接受连接
 //  当 runServer() 检测到新连接时，该函数将被调用。它会尝试接受待处理的连接，实例化一个客户端对象，并添加到客户端映射中。
 void HTTPServer::acceptConnection(){
-    // 使用预设地址信息设置新客户
-    sockaddr_in clientAddr;
-    int32_t clientAddrLen = sizeof(clientAddr);
-    int32_t clfd = INVALID_SOCKET;
-
-    // 接受待处理连接并重新获取客户描述符
-    clfd = accept(listenSocket, (sockaddr*)&clientAddr,(socklen_t*)&clientAddrLen);
-    if(clfd ==INVALID_SOCKET)
-        return;
+    // 一次就绪事件取空接受队列（最多 ACCEPT_BATCH 个），accept4 直接得到非阻塞的描述符
+    for (uint32_t i = 0; i < ACCEPT_BATCH; ++i){
+        // 使用预设地址信息设置新客户
+        sockaddr_in clientAddr;
+        socklen_t clientAddrLen = sizeof(clientAddr);
+
+        // 接受待处理连接并重新获取客户描述符，EAGAIN 表示队列已空（或被其他工作进程抢先）
+        int32_t clfd = accept4(listenSocket, (sockaddr*)&clientAddr, &clientAddrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clfd == INVALID_SOCKET){
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+                std::cout << "accept failed: " << strerror(errno) << std::endl;
+            if (errno == ECONNABORTED)
+                continue;
+            return;
+        }
 
-    // 将socket设置为非阻塞
-    fcntl(clfd, F_SETFL, O_NONBLOCK);
+        // 准入控制：超过全局连接数上限或处于过载状态时，直接写出预渲染的 503 并关闭，不进入事件循环
+        ShedReason reason = SHED_REASON_COUNT;
+        if (maxConnections != 0 && clientMap.size() >= maxConnections)
+            reason = SHED_MAX_CONNECTIONS;
+        else if (admission.shouldShed(std::chrono::steady_clock::now()))
+            reason = SHED_OVERLOAD;
+        if (reason != SHED_REASON_COUNT){
+            admission.recordShed(reason);
+            [[maybe_unused]] auto n = send(clfd, overloadResponse.data(), overloadResponse.size(), MSG_DONTWAIT);
+            close(clfd);
+            continue;
+        }
 
+        addClient(clfd, clientAddr);
+        std::cout << "[" << inet_ntoa(clientAddr.sin_addr) << "] connected" << std::endl;
+        if (workerStats != nullptr)
+            workerStats->accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 开始跟踪一个客户端连接（新接受的或从其他工作进程迁移来的）
+// 描述符已经是非阻塞的：accept4 时设置，迁移来的与发送方共享同一个打开的文件描述，标志随之保留
+// @param clfd 客户端套接字描述符
+// @param addr 客户端地址
+void HTTPServer::addClient(int32_t clfd, sockaddr_in addr){
     // 添加 kqueue 事件，以跟踪新客户端套接字的 “读取 ”和 “写入 ”事件
     updateEvent(clfd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, NULL);
     updateEvent(clfd, EVFILT_WRITE, EV_ADD | EV_DISABLE, 0, 0, NULL);
 
     // 创建一个客户端对象到client map
-    auto cl = std::make_unique<Client>(clfd, clientAddr);
-    std::cout << "[" << cl->getClientIP() << "] connected" << std::endl;
-    clientMap.try_emplace(clfd, std::move(cl));
+    clientMap.try_emplace(clfd, std::make_shared<Client>(clfd, addr));
+    if (workerStats != nullptr)
+        workerStats->active.fetch_add(1, std::memory_order_relaxed);
 }
 
 // get client
@@ -254,6 +1042,10 @@ void HTTPServer::disconnectClient(std::shared_ptr<Client> cl, bool mapErase){
         return;
     }
     std::cout << "[" << cl->getClientIP() << "] disconnected" << std::endl;
+    if (cl->getVhost() != nullptr)
+        cl->getVhost()->releaseConnection();
+    if (workerStats != nullptr)
+        workerStats->active.fetch_sub(1, std::memory_order_relaxed);
     // cong kqueue 中删除套接字事件
     updateEvent(cl->getSocket(), EVFILT_READ, EV_DELETE, 0, 0, NULL);
     updateEvent(cl->getSocket(), EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
@@ -264,6 +1056,10 @@ void HTTPServer::disconnectClient(std::shared_ptr<Client> cl, bool mapErase){
     // 从 clientMap 中删除客户端
     if (mapErase)
         clientMap.erase(cl->getSocket());
+
+    // 通知正在等待该客户端的协程
+    if (cl->hasIoWaiter())
+        cl->takeIoWaiter()(false);
 }
 
 // 读取客户端请求
@@ -294,18 +1090,33 @@ void HTTPServer::readClient(std::shared_ptr<Client> cl, int32_t data_len){
     else if (lenRecv < 0){
         disconnectClient(cl, true);
     } else {
+        cl->touch(time(nullptr));
+        auto now = std::chrono::steady_clock::now();
+        // 按 IP 限速：超过速率的请求不解析，直接用预渲染的 429 拒绝
+        if (rateLimiter != nullptr){
+            auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+            if (!rateLimiter->allow(cl->getClientAddr().sin_addr.s_addr, nowMs)){
+                sendPrerendered(cl, rateLimitResponse);
+                return;
+            }
+        }
         // 把data放入HTTPRequest并发送给handleRequest()处理
-        auto req = new HTTPRequest(pData.get(), lenRecv);
+        // 协程处理函数可能在返回后继续使用请求，因此由共享指针管理
+        auto req = std::make_shared<HTTPRequest>(pData.get(), lenRecv);
         handleRequest(cl, req);
-        delete req;
     }
 }
 
 // 写入client
-// 客户端表示已读写。如果发送队列中有一个项目，则向套接字写入 avail_bytes 字节数
+// 客户端表示已读写。如果发送队列中有一个项目，则向套接字写入至多 avail_bytes 字节数
+// 每次只发送队首的一个项目，由 serviceWrite() 循环调用
 // @param cl 发送数据的客户端指针
-// @param avail_bytes 发送缓冲区中可供写入的字节数
-bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes){
+// @param avail_bytes 最多写入的字节数（写调度器分配的份额，不超过发送缓冲区的可用空间）
+// @param sent 不为 NULL 时输出实际发送的字节数
+// @return 发送队列还有数据且连接未断开时返回 true
+bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes, int32_t* sent){
+    if (sent != nullptr)
+        *sent = 0;
     if(cl == nullptr){
         return false;
     }
@@ -313,16 +1124,6 @@ bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes){
     int32_t actual_sent = 0;  // 实际发送的字节数
     int32_t attempt_sent = 0;  // 尝试发送的字节数
 
-    if (avail_bytes >1400){
-        // 限制最大发送字节数
-        avail_bytes = 1400;
-    }
-    else if (avail_bytes == 0){
-        // 有时操作系统在可以发送数据时报告为 0 - 尝试涓流数据
-        // 操作系统最终会增加可用字节数
-        avail_bytes = 64;
-    }
-
     auto item = cl->nextInSendQueue();
     if (item == nullptr)
         return false;
@@ -340,18 +1141,36 @@ bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes){
         attempt_sent = avail_bytes;
     }
 
+    // 这个项目在本次发完、后面还有项目、份额也足够继续发送时带上 MSG_MORE：
+    // 头部和正文（以及流水线上的下一个响应）由内核合并成尽量少的报文；
+    // 本次的最后一段不带 MSG_MORE，内核立即发出，不会等待 200ms 的 cork 超时
+    int32_t flags = 0;
+    if (attempt_sent == remaining && avail_bytes > remaining && cl->sendQueueSize() > 1 && !disconnect)
+        flags |= SEND_MORE_FLAG;
+
     // 发送数据并按实际发送量递增偏移量
-    actual_sent = send(cl->getSocket(), pData + (item->getOffset()), attempt_sent, 0);
-    if (actual_sent >= 0)
+    actual_sent = send(cl->getSocket(), pData + (item->getOffset()), attempt_sent, flags);
+    if (actual_sent >= 0){
         item->setOffset(item->getOffset() + actual_sent);
-    else
+        cl->markSent(actual_sent);
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // 发送缓冲区已满，等待下一次写事件
+        actual_sent = 0;
+    } else
         disconnect = true;
+    if (actual_sent > 0 && workerStats != nullptr)
+        workerStats->bytesSent.fetch_add(actual_sent, std::memory_order_relaxed);
+    if (sent != nullptr)
+        *sent = actual_sent;
 
     // std::cout << "[" << cl->getClientIP() << "] was sent " << actual_sent << " bytes " << std::endl;
 
     // 不再需要 SendQueueItem。去队列和删除
+    // 带断开标志的项目只有完整发出后才断开连接
     if (item->getOffset() >= item->getSize())
         cl->dequeueFromSendQueue();
+    else if (actual_sent >= 0)
+        disconnect = false;
 
     if (disconnect) {
         disconnectClient(cl, true);
@@ -361,12 +1180,152 @@ bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes){
     return true;
 }
 
+// 登记可写的客户端，由 runWrites() 在本轮事件处理完后发送
+// 剩余待发送量不超过 writePriorityBytes 的进入小响应队列
+// @param cl 客户端
+// @param avail 写事件报告的发送缓冲区可用空间
+void HTTPServer::scheduleWrite(std::shared_ptr<Client> cl, int32_t avail){
+    // 有时操作系统在可以发送数据时报告为 0 - 尝试涓流数据
+    // 操作系统最终会增加可用字节数
+    cl->setWriteAvail(std::max(avail, WRITE_TRICKLE_BYTES));
+    if (cl->isWriteScheduled())
+        return;
+    cl->setWriteScheduled(true);
+    if (writePriorityBytes > 0 && cl->getQueuedBytes() <= writePriorityBytes)
+        writeSmall.push_back(std::move(cl));
+    else
+        writeBulk.push_back(std::move(cl));
+}
+
+// 发送登记的客户端
+// 小响应优先，在发送缓冲区的可用空间内一次发完；其余的按差额轮询，每个连接每轮获得 WRITE_QUANTUM 字节的份额，
+// 份额用完而还可以发送的回到队尾，不能再发送的（内核中的未发送数据已达到目标或发送缓冲区已满）等待下一次写事件。
+// 每轮最多发送 WRITE_ITERATION_BUDGET 字节，没有轮到的连接留在队列中，下一轮先发送
+void HTTPServer::runWrites(){
+    uint64_t budget = WRITE_ITERATION_BUDGET;
+    int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    // 队列中的客户端可能已在本轮断开，套接字描述符也可能已被新连接复用
+    auto live = [this](std::shared_ptr<Client> const& cl){
+        auto it = clientMap.find(cl->getSocket());
+        return it != clientMap.end() && it->second == cl;
+    };
+
+    while (!writeSmall.empty() && budget > 0){
+        auto cl = std::move(writeSmall.front());
+        writeSmall.pop_front();
+        cl->setWriteScheduled(false);
+        if (!live(cl))
+            continue;
+        bool more = false;
+        uint32_t sent = serviceWrite(cl, std::min<uint64_t>(cl->getWriteAvail(), budget), more);
+        budget -= sent;
+        writeSmallBytes += sent;
+        finishWrite(cl, more);
+    }
+
+    // 每轮只遍历一次队列，回到队尾的连接下一轮再获得份额
+    for (size_t n = writeBulk.size(); n > 0 && budget > 0; --n){
+        auto cl = std::move(writeBulk.front());
+        writeBulk.pop_front();
+        if (!live(cl)){
+            cl->setWriteScheduled(false);
+            continue;
+        }
+        uint64_t deficit = cl->getWriteDeficit() + WRITE_QUANTUM;
+        int32_t room = sendAllowance(cl, nowUs);
+        uint32_t quota = std::min<uint64_t>({deficit, (uint64_t)room, budget});
+        bool more = false;
+        uint32_t sent = serviceWrite(cl, quota, more);
+        budget -= sent;
+        writeBulkBytes += sent;
+        cl->setWriteAvail(room - sent);
+        // 没用完的份额最多保留一轮，发送缓冲区满过的连接不会在之后突发
+        cl->setWriteDeficit(more ? std::min<uint64_t>(deficit - sent, WRITE_QUANTUM) : 0);
+
+        if (more && cl->getWriteAvail() > 0 && (sent == quota || budget == 0)){
+            writeBulk.push_back(cl);
+        } else {
+            cl->setWriteScheduled(false);
+        }
+        finishWrite(cl, more);
+    }
+
+    if (budget == 0)
+        ++writeBudgetExhausted;
+}
+
+// 本次最多交给内核的字节数
+// 启用自适应发送时，每个 RTT 采样一次 TCP_INFO，按 cwnd 确定内核中未发送数据的目标（同时是该连接的 TCP_NOTSENT_LOWAT），
+// 可发送量为目标减去 SIOCOUTQNSD 报告的未发送量：高 BDP 的连接一次交给内核更多数据，
+// 低 BDP 的连接其余数据留在发送队列中，内核在需要时才报告可写
+// @param cl 客户端
+// @param nowUs 当前时间（单调时钟，微秒）
+// @return 可发送的字节数；未启用或平台不支持时为写事件报告的可用空间
+int32_t HTTPServer::sendAllowance(std::shared_ptr<Client> const& cl, int64_t nowUs){
+    if (!adaptiveSend)
+        return cl->getWriteAvail();
+    auto& st = cl->getTcpState();
+    if (nowUs >= st.nextSampleUs){
+        bool grown = false;
+        if (TcpFeedback::sample(cl->getSocket(), st, nowUs, sndBufMax, grown))
+            ++tcpSamples;
+        else
+            st.nextSampleUs = INT64_MAX;   // 不支持，不再尝试
+        if (grown)
+            ++sndBufGrown;
+    }
+    if (st.target == 0)
+        return cl->getWriteAvail();
+    int64_t unsent = TcpFeedback::unsent(cl->getSocket());
+    if (unsent < 0)
+        return cl->getWriteAvail();
+    return std::max<int64_t>(st.target - unsent, 0);
+}
+
+// 给客户端发送至多 maxBytes 字节，可以跨越发送队列中的多个项目
+// @param cl 客户端
+// @param maxBytes 最多发送的字节数
+// @param more 输出发送队列是否还有数据，连接已断开时为 false
+// @return 实际发送的字节数
+uint32_t HTTPServer::serviceWrite(std::shared_ptr<Client> const& cl, uint32_t maxBytes, bool& more){
+    uint32_t total = 0;
+    more = true;
+    while (total < maxBytes){
+        int32_t sent = 0;
+        more = writeClient(cl, maxBytes - total, &sent);
+        total += sent;
+        // 发送队列已清空、连接已断开，或者发送缓冲区已满
+        if (!more || sent == 0)
+            break;
+    }
+    return total;
+}
+
+// 发送之后更新客户端的事件
+// @param cl 客户端
+// @param more 发送队列是否还有数据
+void HTTPServer::finishWrite(std::shared_ptr<Client> const& cl, bool more){
+    if (!clientMap.contains(cl->getSocket()))
+        return;
+    // 发送队列回落到低水位以下，恢复读取；挂起的客户端在资源加载完成前不读取新的请求
+    if (cl->isReadPaused() && !cl->isParked() && (!more || cl->getQueuedBytes() < SEND_QUEUE_LOW_WATER)){
+        updateEvent(cl->getSocket(), EVFILT_READ, EV_ENABLE, 0, 0, NULL);
+        cl->setReadPaused(false);
+    }
+    if (!more){
+        updateEvent(cl->getSocket(), EVFILT_WRITE, EV_DISABLE, 0, 0, NULL);
+        // 发送队列已清空，恢复等待发送完成的协程
+        if (cl->hasIoWaiter() && !cl->isWaitingRead() && cl->sendQueueSize() == 0)
+            cl->takeIoWaiter()(true);
+    }
+}
+
 // 处理来自客户端的请求。将请求发送到相应的处理函数
 //  对应 HTTP 操作（GET、HEAD 等)
 //  @param cl 客户端对象，请求来自该对象
 //  @param req HTTPRequest 对象，包含原始数据包数据
 
-void HTTPServer::handleRequest(std::shared_ptr<Client> cl, HTTPRequest* const req){
+void HTTPServer::handleRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req){
     // 解析 request
     // 如果有错误，发送错误响应
     if (!req->parse()){
@@ -376,24 +1335,46 @@ void HTTPServer::handleRequest(std::shared_ptr<Client> cl, HTTPRequest* const re
         return;
     }
     std::cout << "[" << cl->getClientIP() << "] " << req->methodIntToStr(req->getMethod()) << " " << req->getRequestUri() << std::endl;
+    if (workerStats != nullptr)
+        workerStats->requests.fetch_add(1, std::memory_order_relaxed);
 
-    // 发送request 到correct handler
-    switch (req->getMethod()){
-        case Method(HEAD):
-        case Method(GET):
-            handleGet(cl, req);
-            break;
-        case Method(OPTIONS):
-            handleOptions(cl, req);
-            break;
-        case Method(TRACE):
-            handleTrace(cl, req);
-            break;
-        default:
-            std::cout << "[" << cl->getClientIP() << "] Could not handle or determine request of type " << req->methodIntToStr(req->getMethod()) << std::endl;
-            sendStatusResponse(cl, Status(NOT_IMPLEMENTED));
-            break;
+    // 请求的排队时间：从这一轮取出事件到开始处理它，不含它自己的服务时间
+    auto dispatchTime = std::chrono::steady_clock::now();
+    admission.observe(DELAY_SOJOURN, dispatchTime - loopStart, dispatchTime);
+
+    // 准入控制：过载时快速拒绝；连接按请求的虚拟主机计数，超过其上限时拒绝
+    if (admission.shouldShed(dispatchTime)){
+        shedRequest(cl, SHED_OVERLOAD);
+        return;
+    }
+    if (auto resHost = getResourceHostForRequest(req.get()); resHost != nullptr && resHost != cl->getVhost()){
+        if (!resHost->acquireConnection()){
+            shedRequest(cl, SHED_VHOST_CONNECTIONS);
+            return;
+        }
+        if (cl->getVhost() != nullptr)
+            cl->getVhost()->releaseConnection();
+        cl->setVhost(resHost);
     }
+
+    // 按 方法 + 路径 查找处理函数：虚拟主机自己的路由优先
+    auto uri = req->getRequestUri();
+    std::string_view path = std::string_view(uri).substr(0, uri.find('?'));
+    RouteParams params;
+    RouteHandler const* handler = nullptr;
+    if (!gen->hostRouters.empty()){
+        if (auto it = gen->hostRouters.find(getHostNameForRequest(req.get())); it != gen->hostRouters.end())
+            handler = it->second->lookup(req->getMethod(), path, params);
+    }
+    if (handler == nullptr)
+        handler = globalRouter.lookup(req->getMethod(), path, params);
+
+    if (handler == nullptr){
+        std::cout << "[" << cl->getClientIP() << "] Could not handle or determine request of type " << req->methodIntToStr(req->getMethod()) << std::endl;
+        sendStatusResponse(cl, Status(NOT_IMPLEMENTED));
+        return;
+    }
+    (*handler)(cl, req, params);
 }
 
 //  处理 GET 或 HEAD 请求，为客户端提供适当的响应
@@ -407,38 +1388,287 @@ void HTTPServer::handleGet(std::shared_ptr<Client> cl, HTTPRequest* const req){
         sendStatusResponse(cl, Status(BAD_REQUEST), "Invalid/No Host specified");
         return
     }
-    // 检查被请求资源是否存在
+    bool dc = shouldDisconnect(req);
+
     auto uri = req->getRequestUri();
-    auto r = resHost->getResource(uri);
-    if (r!= nullptr){
-        std::cout << "[" << cl->getClientIP() << "] " << "Sending file: " << uri << std::endl;
 
-        auto resp = std::make_unique<HTTPResponse>();
-        resp->setStatus(Status(OK));
-        resp->addHeader("Content-Type", r->getMimeType());
-        resp->addHeader("Content-Length", r->getSize());
-
-        // 只有在 GET 请求时才发送信息正文
-        if (req->getMethod() == Method(GET))
-            resp->setData(r->getData(), r->getSize());
-        
-        bool dc = false;
-        // HTTP/1.0 默认关闭连接
-        if (req->getVersion().compare(HTTP_VERSION_10) == 0)
-            dc = true;
-        
-        // 如果指定了连接：关闭，则应在请求处理完毕后终止连接
-        if (auto con_val = req->getHeader("Connection"); con_val.compare("close")==0)
-            dc = true;
-
-        sendResponse(cl, std::move(resp), dc);
-
-    }else{
-        // 资源不存在
+    // 内存或资源包后端：直接在事件循环线程上响应，不访问磁盘
+    if (resHost->isNonBlocking()){
+        bool gzip = req->getHeaderValue("Accept-Encoding").contains("gzip");
+        if (auto r = resHost->lookupResource(uri, gzip); r != nullptr){
+            sendResource(cl, r, req->getMethod(), dc);
+        } else {
+            std::cout << "[" << cl->getClientIP() << "] " << "File not found: " << uri << std::endl;
+            sendStatusResponse(cl, Status(NOT_FOUND));
+        }
+        return;
+    }
+
+    // 内容缓存命中时直接在事件循环线程上响应
+    if (auto r = lookupCached(resHost, uri); r != nullptr){
+        sendResource(cl, r, req->getMethod(), dc);
+        return;
+    }
+
+    // 已确认不存在（目录变更前不会改变）：直接用预渲染的 404 响应，不提交加载任务
+    if (resHost->isMissing(uri)){
         std::cout << "[" << cl->getClientIP() << "] " << "File not found: " << uri << std::endl;
-        sendStatusResponse(cl, Status(NOT_FOUND));
+        sendPrerendered(cl, notFoundResponse);
+        return;
     }
+
+    // 未命中：交给 I/O 线程池加载
+    loadResourceAsync(cl, resHost, uri, req->getMethod(), dc);
+}
+
+// 在 I/O 线程池上加载资源
+// 加载完成前客户端被挂起（不读取新请求），完成后回到事件循环线程发送响应并放入内容缓存
+// 对同一 URI 的并发请求只发起一次加载，其余请求挂在该次加载的结果上
+// 线程池队列已满时客户端保持挂起，加载暂存到有空位时再提交
+// @param cl 请求资源的客户端
+// @param resHost 资源所在的资源主机
+// @param uri 请求的 URI
+// @param method 请求方法（HEAD 不发送正文）
+// @param dc 发送后是否断开连接
+void HTTPServer::loadResourceAsync(std::shared_ptr<Client> cl, std::shared_ptr<ResourceHost> resHost,
+                                   std::string const& uri, uint32_t method, bool dc){
+    std::weak_ptr<Client> wcl = cl;
+    auto waiter = [this, wcl, uri, method, dc](std::shared_ptr<Resource> r){
+        // 加载期间客户端可能已经断开
+        auto live = wcl.lock();
+        if (live == nullptr || !clientMap.contains(live->getSocket()))
+            return;
+        live->setParked(false);
+        if (r != nullptr){
+            sendResource(live, r, method, dc);
+        } else {
+            std::cout << "[" << live->getClientIP() << "] " << "File not found: " << uri << std::endl;
+            sendStatusResponse(live, Status(NOT_FOUND));
+        }
+        // 响应已排队，让 kqueue 开始跟踪 “写入 ”事件
+        updateEvent(live->getSocket(), EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+    };
+
+    cl->setParked(true);
+    startLoad(resHost, uri, waiter);
 }
+
+// 发起资源加载
+// 对同一 URI 的并发加载只执行一次，waiter 在加载完成后于事件循环线程上调用（不会在返回前调用）
+// @param resHost 资源所在的资源主机
+// @param uri 请求的 URI
+// @param waiter 加载完成后调用的回调，资源不存在时参数为 NULL
+void HTTPServer::startLoad(std::shared_ptr<ResourceHost> resHost, std::string const& uri,
+                           std::function<void(std::shared_ptr<Resource>)> waiter){
+    // 已有相同 URI 的加载在进行中，等待其结果即可
+    if (!resHost->joinLoad(uri, std::move(waiter)))
+        return;
+
+    // 缓存中已过期的资源在 I/O 线程上向后端确认，未变化时沿用，不再读取文件
+    auto cached = resHost->getExpiredResource(uri);
+    auto loaded = std::make_shared<std::shared_ptr<Resource>>();
+    // 资源不存在且后端记入了负缓存时，事件循环侧也记住它（加载期间目录发生变化则不记）
+    auto missingWd = std::make_shared<int32_t>(-1);
+    uint64_t seq = resHost->getNotifySeq();
+    IOTask task;
+    task.work = [resHost, uri, loaded, cached, missingWd]{
+        if (cached != nullptr && resHost->isFresh(*cached))
+            *loaded = cached;
+        else
+            *loaded = resHost->getResource(uri);
+        if (*loaded == nullptr)
+            *missingWd = resHost->getMissingWatch(uri);
+    };
+    task.done = [resHost, uri, loaded, missingWd, seq]{
+        if (*missingWd != -1)
+            resHost->addMissing(uri, *missingWd, seq);
+        resHost->finishLoad(uri, *loaded);
+    };
+    submitIO(std::move(task));
+}
+
+// 从内容缓存中查找资源
+// 需要重新确认的条目照常返回（stale-while-revalidate），同时在后台发起一次确认：
+// 未变化时只延长有效期，已变化或已删除时由 finishLoad() 替换或删除缓存条目
+// 确认与普通加载共用 single-flight，同一 URI 同时只有一次在进行
+// @param resHost 资源所在的资源主机
+// @param uri 请求的 URI
+// @return 缓存的资源，未命中时返回 NULL
+std::shared_ptr<Resource> HTTPServer::lookupCached(std::shared_ptr<ResourceHost> const& resHost, std::string const& uri){
+    bool stale = false;
+    auto r = resHost->getCachedResource(uri, &stale);
+    if (stale && !resHost->isLoading(uri))
+        startLoad(resHost, uri, [](std::shared_ptr<Resource>){});
+    return r;
+}
+
+// 发送资源
+// 为已加载的资源构造 200 响应
+// @param cl 请求资源的客户端
+// @param r 资源对象
+// @param method 请求方法，只有 GET 请求才发送正文
+// @param dc 发送后是否断开连接
+void HTTPServer::sendResource(std::shared_ptr<Client> cl, std::shared_ptr<Resource> r, uint32_t method, bool dc){
+    std::cout << "[" << cl->getClientIP() << "] " << "Sending file: " << r->getLocation() << std::endl;
+
+    HTTPResponse resp;
+    resp.setStatus(Status(OK));
+    resp.addHeader("Content-Type", r->getMimeType());
+    resp.addHeader("Content-Length", r->getSize());
+    if (auto etag = r->getEtag(); !etag.empty())
+        resp.addHeader("ETag", etag);
+    if (auto ce = r->getContentEncoding(); !ce.empty()){
+        resp.addHeader("Content-Encoding", ce);
+        resp.addHeader("Vary", "Accept-Encoding");
+    }
+    SendQueueItem* header = finishResponse(resp, dc);
+
+    // 只有在 GET 请求时才发送信息正文
+    // 正文不复制：发送队列项直接引用缓存中资源的数据，并持有资源的引用（被引用的资源也不会被 arena 整理移动），
+    // 发送时与头部合并成尽量少的报文（见 writeClient）
+    if (method == Method(GET) && r->getSize() > 0){
+        header->setDisconnect(false);
+        cl->addToSendQueue(header);
+        cl->addToSendQueue(new SendQueueItem(r, r->getData(), r->getSize(), dc));
+    } else {
+        cl->addToSendQueue(header);
+    }
+}
+
+// 响应是否应在发送后断开连接
+// @param req 请求
+bool HTTPServer::shouldDisconnect(const HTTPRequest* const req) const {
+    // 升级后排空，不再保持连接
+    if (draining)
+        return true;
+
+    // HTTP/1.0 默认关闭连接
+    if (req->getVersion().compare(HTTP_VERSION_10) == 0)
+        return true;
+
+    // 如果指定了连接：关闭，则应在请求处理完毕后终止连接
+    if (auto con_val = req->getHeaderValue("Connection"); con_val.compare("close")==0)
+        return true;
+    return false;
+}
+
+// 与其他工作进程平衡连接数（prefork，每秒一次）
+// 连接数明显高于平均值时暂停接受新连接（共享的监听套接字上的连接由其他工作进程接受），
+// 并把空闲最久的保持连接迁移给连接数最少的工作进程；回落到阈值以下后恢复接受
+// @param now 当前时间
+void HTTPServer::rebalance(time_t now){
+    if (statsSegment == nullptr || statsSegment->workers < 2 || listenSocket == INVALID_SOCKET)
+        return;
+    int64_t mean = statsSegment->getMeanActive();
+    int64_t active = workerStats->active.load(std::memory_order_relaxed);
+    int64_t excess = active - mean;
+    bool hot = active > mean * REBALANCE_HIGH_RATIO && excess >= REBALANCE_MIN_EXCESS;
+
+    if (hot != acceptPaused){
+        acceptPaused = hot;
+        updateEvent(listenSocket, EVFILT_READ, hot ? EV_DISABLE : EV_ENABLE, 0, 0, NULL);
+        workerStats->acceptPaused.store(hot, std::memory_order_relaxed);
+        std::cout << "Worker " << workerSlot << (hot ? " pausing" : " resuming") << " accept (" << active
+                  << " connections, mean " << mean << ")" << std::endl;
+    }
+    if (!hot)
+        return;
+
+    int32_t target = statsSegment->getLeastLoaded(workerSlot);
+    if (target < 0 || statsSegment->slots[target].outbox == -1)
+        return;
+    // 只迁移到平均值：迁移太多会让目标进程变成新的热点
+    auto& dest = statsSegment->slots[target];
+    int64_t room = mean - dest.active.load(std::memory_order_relaxed);
+    if (room <= 0)
+        return;
+    uint32_t quota = std::min<int64_t>({excess / 2, room, REBALANCE_BATCH});
+
+    std::vector<std::shared_ptr<Client>> idle;
+    for (auto const& [clfd, cl] : clientMap){
+        if (cl->isIdle() && now - cl->getLastActive() >= REBALANCE_IDLE_SECONDS)
+            idle.push_back(cl);
+    }
+    std::sort(idle.begin(), idle.end(), [](auto const& a, auto const& b){
+        return a->getLastActive() < b->getLastActive();
+    });
+    uint32_t moved = 0;
+    for (auto const& cl : idle){
+        if (moved >= quota || !migrateClient(cl, dest))
+            break;
+        ++moved;
+    }
+    if (moved > 0)
+        std::cout << "Worker " << workerSlot << " migrated " << moved << " idle connections to worker " << target << std::endl;
+}
+
+// 把空闲的保持连接交给另一个工作进程
+// 描述符通过对方的收件箱传递，之后本进程关闭自己的描述符；连接上已经到达但还没读取的数据留在内核里，由对方读取
+// @param cl 空闲的客户端
+// @param target 目标工作进程
+// @return 对方收件箱已满等原因失败时返回 false，连接保留在本进程
+bool HTTPServer::migrateClient(std::shared_ptr<Client> cl, WorkerStats& target){
+    MigratedClient state;
+    state.addr = cl->getClientAddr();
+    state.lastActive = cl->getLastActive();
+    if (!Upgrade::sendFd(target.outbox, cl->getSocket(), &state, sizeof(state)))
+        return false;
+
+    updateEvent(cl->getSocket(), EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    updateEvent(cl->getSocket(), EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+    close(cl->getSocket());
+    clientMap.erase(cl->getSocket());
+    if (cl->getVhost() != nullptr)
+        cl->getVhost()->releaseConnection();
+    workerStats->active.fetch_sub(1, std::memory_order_relaxed);
+    workerStats->migratedOut.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// 接收其他工作进程迁移过来的连接
+void HTTPServer::adoptClients(){
+    MigratedClient state;
+    int32_t clfd;
+    while ((clfd = Upgrade::recvFd(workerStats->inbox, &state, sizeof(state))) != -1){
+        addClient(clfd, state.addr);
+        clientMap[clfd]->touch(state.lastActive);
+        workerStats->migratedIn.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 处理 /health 请求
+// 进程在运行、事件循环能响应即视为健康
+// @param cl 请求资源的客户端
+// @param req 请求状态
+void HTTPServer::handleHealth(std::shared_ptr<Client> cl, const HTTPRequest* const req){
+    static const std::string body = "OK\n";
+
+    auto resp = std::make_unique<HTTPResponse>();
+    resp->setStatus(Status(OK));
+    resp->addHeader("Content-Type", "text/plain");
+    resp->addHeader("Content-Length", body.length());
+    if (req->getMethod() == Method(GET))
+        resp->setData((uint8_t*)body.data(), body.length());
+    sendResponse(cl, std::move(resp), shouldDisconnect(req));
+}
+
+// 处理 /metrics 请求
+// 以 Prometheus 文本格式返回 getMetrics() 的内容
+// @param cl 请求资源的客户端
+// @param req 请求状态
+void HTTPServer::handleMetrics(std::shared_ptr<Client> cl, const HTTPRequest* const req){
+    std::string body = getMetrics();
+
+    auto resp = std::make_unique<HTTPResponse>();
+    resp->setStatus(Status(OK));
+    resp->addHeader("Content-Type", "text/plain; version=0.0.4");
+    resp->addHeader("Content-Length", body.length());
+    // create() 会复制正文
+    if (req->getMethod() == Method(GET))
+        resp->setData((uint8_t*)body.data(), body.length());
+    sendResponse(cl, std::move(resp), shouldDisconnect(req));
+}
+
 // 处理 OPTIONS 请求
 // OPTIONS 返回服务器 (*) 或特定资源允许的能力
 // @param cl 请求资源的客户端
@@ -460,53 +1690,114 @@ void HTTPServer::handleOptions(std::shared_ptr<Client> cl, [[maybe_unused]] cons
 // @param cl 请求资源的客户端
 // @param req 请求状态
 void HTTPServer::handleTrace(std::shared_ptr<Client> cl, HTTPRequest* const req) {
-    // 获取请求的字节数组表示
+    // 获取请求的字节数组表示（请求对象在返回后即被释放，必须先复制）
     uint32_t len = req->size();
-    auto buf = std::make_unique<uint8_t[]>(len);
+    std::shared_ptr<uint8_t[]> buf(new uint8_t[len]);
     req->setReadPos(0); //将读取位置设置在起始位置，因为请求已被读取到终点
     req->getBytes(buf.get(), len);
 
     // 发送以整个请求为正文的响应
-    auto resp = std::make_unique<HTTPResponse>();
-    resp->setStatus(Status(OK));
-    resp->addHeader("Content-Type", "message/http");
-    resp->addHeader("Content-Length", len);
-    resp->setData(buf.get(), len);
-    sendResponse(cl, std::move(resp), true);
+    auto build = [buf, len]{
+        auto resp = std::make_unique<HTTPResponse>();
+        resp->setStatus(Status(OK));
+        resp->addHeader("Content-Type", "message/http");
+        resp->addHeader("Content-Length", len);
+        resp->setData(buf.get(), len);
+        return resp;
+    };
+
+    // 很大的请求体在 CPU 线程池上构造响应
+    if (len >= CPU_OFFLOAD_BYTES)
+        offloadResponse(cl, build, true);
+    else
+        sendResponse(cl, build(), true);
 }
 
 // 发送状态响应
 //  向客户端发送预定义的 HTTP 状态代码响应，其中只包含状态代码和所需的标头，然后断开客户端连接
 //  @param cl 要向其发送状态代码的客户端 与 HTTPMessage.h 中的枚举相对应的状态代码
 //  @param msg 附加到正文的额外信息
-void HTTPServer::sendStatusResponse(std::shared_ptr<client> cl, int32_t status, const std::string const& msg){
+void HTTPServer::sendStatusResponse(std::shared_ptr<Client> cl, int32_t status, std::string const& msg){
     auto resp = std::make_unique<HTTPResponse>();
     resp->setStatus(status);
 
     // body: reason string + additional msg
-    std::string body = resp->getReason();
-    if (msg.length() > 0 )
-        body += ": " + msg;
-    
-    uint32_t slen = body.length();
-    auto sdata = new uint8_t[slen];
-    memset(sdata, 0x00, slen);
-    strncpy((char*)sdata, body.c_str(), slen);
+    // 不带附加信息的正文（如重复的 404）只渲染一次，之后直接从内存取用
+    std::string body;
+    std::string const* pbody = &body;
+    if (msg.length() > 0){
+        body = resp->getReason() + ": " + msg;
+    } else {
+        auto it = statusBodies.find(status);
+        if (it == statusBodies.end())
+            it = statusBodies.try_emplace(status, resp->getReason()).first;
+        pbody = &it->second;
+    }
+    uint32_t slen = pbody->length();
 
     resp->addHeader("Content-Type", "text/plain");
     resp->addHeader("Content-Length", slen);
-    resp->setData(sdata, slen);
+    // create() 会复制正文，因此可以直接引用缓存中的字符串
+    resp->setData((uint8_t*)pbody->data(), slen);
 
     sendResponse(cl, std::move(resp), true);
 }
 
+// 渲染过载时使用的 503 响应、限速时使用的 429 响应和负缓存命中时使用的 404 响应
+// 完整的响应（状态行、标头和正文）只渲染一次，拒绝时直接复制，不经过 finishResponse()
+void HTTPServer::renderOverloadResponse(){
+    auto render = [](int32_t status, uint32_t retryAfter, std::string& out){
+        HTTPResponse resp;
+        resp.setStatus(Status(status));
+        std::string body = resp.getReason();
+        resp.addHeader("Server", "httpserver/1.0");
+        resp.addHeader("Content-Type", "text/plain");
+        resp.addHeader("Content-Length", body.length());
+        if (retryAfter != 0)
+            resp.addHeader("Retry-After", retryAfter);
+        resp.addHeader("Connection", "close");
+        resp.setData((uint8_t*)body.data(), body.length());
+        auto raw = resp.create();
+        out.assign((char const*)raw.get(), resp.size());
+    };
+    render(SERVICE_UNAVAILABLE, ADMISSION_RETRY_AFTER, overloadResponse);
+    render(TOO_MANY_REQUESTS, RATE_LIMIT_RETRY_AFTER, rateLimitResponse);
+    render(NOT_FOUND, 0, notFoundResponse);
+}
+
+// 用预渲染的 503 拒绝请求，发送后断开连接
+// @param cl 客户端
+// @param reason 拒绝的原因
+void HTTPServer::shedRequest(std::shared_ptr<Client> cl, ShedReason reason){
+    admission.recordShed(reason);
+    sendPrerendered(cl, overloadResponse);
+}
+
+// 发送预渲染的完整响应，发送后断开连接
+// @param cl 客户端
+// @param raw 响应
+void HTTPServer::sendPrerendered(std::shared_ptr<Client> cl, std::string const& raw){
+    auto data = std::make_unique<uint8_t[]>(raw.size());
+    memcpy(data.get(), raw.data(), raw.size());
+    cl->addToSendQueue(new SendQueueItem(std::move(data), raw.size(), true));
+}
+
 // 发送 response
 // 向特定客户端发送通用 HTTPResponse 数据包
 //  * @param Cl 待发送的客户端
 //  * @param buf 含有待发送数据的字节缓冲区
 //  * @param disconnect 服务器是否应在发送后断开与客户端的连接（可选，默认 = false）
 void HTTPServer::sendResponse(std::shared_ptr<Client> cl, std::unique_ptr<HTTPResponse> resp, bool disconnect){
-    resp->addHeader("Server", "httpserver/1.0");
+    cl->addToSendQueue(finishResponse(*resp, disconnect));
+}
+
+// 补全通用标头并生成发送队列项
+// 不访问服务器状态，可以在 CPU 线程池上调用
+// @param resp 待发送的响应
+// @param disconnect 发送后是否断开连接
+// @return 包含完整响应数据的发送队列项
+SendQueueItem* HTTPServer::finishResponse(HTTPResponse& resp, bool disconnect){
+    resp.addHeader("Server", "httpserver/1.0");
 
     // 使用日期标头对响应进行时间标记
     std::string tstr;
@@ -517,41 +1808,87 @@ void HTTPServer::sendResponse(std::shared_ptr<Client> cl, std::unique_ptr<HTTPRe
     if (gmtime_r(&rawtime, &ptm) != nullptr){
         strftime(tbuf, 36, "%a, %d %b %Y %H:%M:%S GMT", &ptm);
         tstr = tbuf;
-        resp->addHeader("Date", tstr);
+        resp.addHeader("Date", tstr);
     }
     // 如果这是服务器发送的最终响应，则包含 Connection: close 头信息
     if (disconnect){
-        resp->addHeader("Connection", "close");
+        resp.addHeader("Connection", "close");
     }
 
     // 通过创建响应获取原始数据（我们负责在 process() 中对其进行清理）
-    // 将数据添加到客户端的发送队列中
-    cl->addToSendQueue(new SendQueueItem(resp->create(), resp->size(), disconnect));
+    return new SendQueueItem(resp.create(), resp.size(), disconnect);
+}
+
+// 在 CPU 线程池上构造并生成响应
+// 构造期间客户端被挂起（不读取新请求），完成后回到事件循环线程放入发送队列
+// 线程池不可用或已满时退回到同步构造
+// @param cl 待发送的客户端
+// @param build 构造响应的函数，在工作线程上执行，捕获的数据必须在构造期间保持有效
+// @param disconnect 发送后是否断开连接
+void HTTPServer::offloadResponse(std::shared_ptr<Client> cl, std::function<std::unique_ptr<HTTPResponse>()> build, bool disconnect){
+    auto item = std::make_shared<std::unique_ptr<SendQueueItem>>();
+    CpuTask task;
+    task.work = [build, disconnect, item]{
+        auto resp = build();
+        item->reset(finishResponse(*resp, disconnect));
+    };
+
+    std::weak_ptr<Client> wcl = cl;
+    task.done = [this, wcl, item]{
+        // 构造期间客户端可能已经断开
+        auto live = wcl.lock();
+        if (live == nullptr || !clientMap.contains(live->getSocket()))
+            return;
+        live->setParked(false);
+        live->addToSendQueue(item->release());
+        updateEvent(live->getSocket(), EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+    };
+
+    cl->setParked(true);
+    if (cpuPool != nullptr && cpuPool->submit(task))
+        return;
+
+    // 线程池不可用或已满，在当前线程上同步构造
+    cl->setParked(false);
+    task.work();
+    cl->addToSendQueue(item->release());
+}
+
+// 根据目录变更通知描述符查找资源主机
+// @param fd 触发事件的描述符
+// @return 对应的资源主机，不是通知描述符时返回 NULL
+std::shared_ptr<ResourceHost> HTTPServer::getHostForNotifyFd(int fd) const {
+    for (auto const& host : gen->hostList){
+        if (host->getNotifyFd() == fd)
+            return host;
+    }
+    return nullptr;
+}
+
+// 获取请求所属虚拟主机的名字，与 getResourceHostForRequest() 的选择规则相同
+// @param req 请求状态
+// @return 主机名（可能带端口，查找按裸主机名进行），没有合适的主机时返回空
+std::string_view HTTPServer::getHostNameForRequest(const HTTPRequest* const req) const {
+    if (auto host = req->getHeaderView("Host"); !host.empty()){
+        if (gen->hostTable.find(host) != nullptr)
+            return HostTable::bareHost(host);
+    }
+    if (gen->hostTable.hasExplicitDefault() || req->getVersion().compare(HTTP_VERSION_11) != 0)
+        return gen->hostTable.getDefaultName();
+    return {};
 }
 
 // 获取资源主机
 //  根据请求的路径 检索 适当的 ResourceHost 实例 
 //  @param req 请求状态
 std::shared_ptr<ResourceHost> HTTPServer::getResourceHostForRequest(const HTTPRequest* const req){
-    // 确定合适的虚拟主机
-    std::string host = "";
-    //  读取请求中指定的主机（符合 HTTP/1.1 要求）
-    if (req->getVersion().compare(HTTP_VERSION_11) == 0){
-        host = req->getHeaderValue("Host");
-        // 所有虚拟主机都附加了端口，因此如果不存在端口，则需要将其附加到主机上
-        if (!host.contains(":")){
-            host.append(":" + listenPort);
-        }
-        auto it = vhosts.find(host);
-
-        if (it != vhosts.end()){
-            return it->second;
-        }
-    } else {
-        // Temporary： HTTP/1.0 会给出 hostList 中的第一个资源主机
-        // TODO: 允许管理员指定 "默认资源主机
-        if (!hostList.empty())
-            return hostList[0];
+    // 确定合适的虚拟主机：按 Host 头的裸主机名查找，不区分大小写，不复制
+    if (auto host = req->getHeaderView("Host"); !host.empty()){
+        if (auto resHost = gen->hostTable.find(host); resHost != nullptr)
+            return resHost;
     }
+    // HTTP/1.0 可以不发送 Host，由默认主机响应；HTTP/1.1 的未知主机只有在配置了默认主机时才由它响应
+    if (gen->hostTable.hasExplicitDefault() || req->getVersion().compare(HTTP_VERSION_11) != 0)
+        return gen->hostTable.getDefault();
     return nullptr;
 }
@@ -0,0 +1,94 @@
+#include "HostTable.h"
+
+#include <cctype>
+#include <iostream>
+
+// FNV-1a，按小写字符计算
+size_t HostTable::CaseInsensitiveHash::operator()(std::string_view s) const {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s){
+        h ^= (uint64_t)tolower(c);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+bool HostTable::CaseInsensitiveEqual::operator()(std::string_view a, std::string_view b) const {
+    if (a.length() != b.length())
+        return false;
+    for (size_t i = 0; i < a.length(); ++i){
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+            return false;
+    }
+    return true;
+}
+
+// 从 Host 头中取出裸主机名
+// 去掉端口（IPv6 字面量形如 [::1]:8080）和表示根域的末尾 '.'
+// @param host Host 头的值
+// @return 指向 host 内部的视图
+std::string_view HostTable::bareHost(std::string_view host){
+    if (host.starts_with('[')){
+        size_t close = host.find(']');
+        if (close != std::string_view::npos)
+            host = host.substr(0, close + 1);
+    } else if (size_t colon = host.rfind(':'); colon != std::string_view::npos){
+        host = host.substr(0, colon);
+    }
+    if (host.ends_with('.'))
+        host.remove_suffix(1);
+    return host;
+}
+
+// 添加虚拟主机，第一个添加的主机成为默认主机（除非配置另行指定）
+// @param host 主机名（可以带端口，端口被忽略）
+// @param resHost 为该主机提供服务的资源主机
+// @return 主机名为空或过长时返回 false
+bool HostTable::add(std::string_view host, std::shared_ptr<ResourceHost> resHost){
+    host = bareHost(host);
+    if (host.empty() || host.length() > HOST_NAME_MAX_LEN){
+        std::cout << "vhost " << host << " is empty or too long, skipping" << std::endl;
+        return false;
+    }
+    std::string key(host);
+    for (auto& c : key)
+        c = tolower((unsigned char)c);
+    if (defaultHost == nullptr){
+        defaultHost = resHost;
+        defaultName = key;
+    }
+    hosts.insert_or_assign(std::move(key), std::move(resHost));
+    return true;
+}
+
+// 查找虚拟主机
+// @param host Host 头的值（可以带端口，不区分大小写）
+// @return 资源主机，未注册时返回 NULL
+std::shared_ptr<ResourceHost> HostTable::find(std::string_view host) const {
+    auto it = hosts.find(bareHost(host));
+    if (it == hosts.end())
+        return nullptr;
+    return it->second;
+}
+
+// 指定默认虚拟主机：HTTP/1.0 请求和未匹配任何主机的请求由它响应
+// @param host 已添加的主机名
+// @return 主机不存在时返回 false
+bool HostTable::setDefault(std::string_view host){
+    auto resHost = find(host);
+    if (resHost == nullptr)
+        return false;
+    defaultHost = resHost;
+    defaultName = bareHost(host);
+    for (auto& c : defaultName)
+        c = tolower((unsigned char)c);
+    explicitDefault = true;
+    return true;
+}
+
+void HostTable::clear(){
+    hosts.clear();
+    defaultHost = nullptr;
+    defaultName.clear();
+    explicitDefault = false;
+}
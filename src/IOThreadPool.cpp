@@ -0,0 +1,97 @@
+#include "IOThreadPool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// 创建唤醒管道并启动工作线程
+// @param numThreads 工作线程数
+// @param pendingLimit 队列中最多等待的任务数，超出时 submit() 失败
+IOThreadPool::IOThreadPool(uint32_t numThreads, uint32_t pendingLimit) : maxPending(pendingLimit){
+    if (pipe(wakePipe) == 0){
+        // 两端都设为非阻塞：写满时丢弃唤醒字节即可（事件循环总会被已写入的字节唤醒）
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(wakePipe[1], F_SETFD, FD_CLOEXEC);
+    }
+    if (numThreads == 0)
+        numThreads = 1;
+    for (uint32_t i = 0; i < numThreads; ++i)
+        workers.emplace_back(&IOThreadPool::workerLoop, this);
+}
+
+// 通知所有工作线程退出并等待其结束。尚未执行的任务被丢弃
+IOThreadPool::~IOThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopping = true;
+        pending.clear();
+    }
+    pendingCv.notify_all();
+    for (auto& t : workers)
+        t.join();
+
+    for (auto& fd : wakePipe){
+        if (fd != -1){
+            close(fd);
+            fd = -1;
+        }
+    }
+}
+
+// 工作线程主循环：取出任务执行 work，然后放入完成队列并唤醒事件循环
+void IOThreadPool::workerLoop(){
+    while (true){
+        IOTask task;
+        {
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            pendingCv.wait(lock, [this]{ return stopping || !pending.empty(); });
+            if (stopping)
+                return;
+            task = std::move(pending.front());
+            pending.pop_front();
+        }
+
+        if (task.work)
+            task.work();
+
+        {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            completed.push_back(std::move(task));
+        }
+        char b = 1;
+        [[maybe_unused]] ssize_t n = write(wakePipe[1], &b, 1);
+    }
+}
+
+// 提交一项任务
+// @param task 要执行的任务
+// @return 队列已满或线程池正在停止时返回 false，调用者应自行同步处理
+bool IOThreadPool::submit(IOTask task){
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (stopping || pending.size() >= maxPending)
+            return false;
+        pending.push_back(std::move(task));
+    }
+    pendingCv.notify_one();
+    return true;
+}
+
+// 执行所有已完成任务的 done 回调
+// 必须在事件循环线程上调用（唤醒描述符可读时）
+void IOThreadPool::runCompletions(){
+    // 清空管道中的唤醒字节
+    char buf[256];
+    while (read(wakePipe[0], buf, sizeof(buf)) > 0){}
+
+    std::deque<IOTask> ready;
+    {
+        std::lock_guard<std::mutex> lock(completedMutex);
+        ready.swap(completed);
+    }
+    for (auto& task : ready){
+        if (task.done)
+            task.done();
+    }
+}
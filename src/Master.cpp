@@ -0,0 +1,348 @@
+#include "Master.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// master 的信号只设置标志，由 run() 的循环处理
+static volatile sig_atomic_t g_masterStop = 0;
+static volatile sig_atomic_t g_masterReload = 0;
+static volatile sig_atomic_t g_masterUpgrade = 0;
+
+static void handleMasterStop([[maybe_unused]] int32_t snum){
+    g_masterStop = 1;
+}
+
+static void handleMasterReload([[maybe_unused]] int32_t snum){
+    g_masterReload = 1;
+}
+
+static void handleMasterUpgrade([[maybe_unused]] int32_t snum){
+    g_masterUpgrade = 1;
+}
+
+// 只为打断 sigsuspend()，退出的工作进程由 waitpid() 回收
+static void handleMasterChild([[maybe_unused]] int32_t snum){
+}
+
+// 导出所有工作进程的计数器（Prometheus 文本格式），附带各项的合计
+std::string StatsSegment::getMetrics() const {
+    std::string ret;
+    uint64_t accepted = 0;
+    int64_t active = 0;
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < workers; ++i){
+        auto const& w = slots[i];
+        std::string label = "{worker=\"" + std::to_string(i) + "\"} ";
+        ret += "worker_pid" + label + std::to_string(w.pid.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_restarts_total" + label + std::to_string(w.restarts.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_connections_accepted_total" + label + std::to_string(w.accepted.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_connections_active" + label + std::to_string(w.active.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_requests_total" + label + std::to_string(w.requests.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_bytes_sent_total" + label + std::to_string(w.bytesSent.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_connections_migrated_in_total" + label + std::to_string(w.migratedIn.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_connections_migrated_out_total" + label + std::to_string(w.migratedOut.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_accept_paused" + label + std::to_string(w.acceptPaused.load(std::memory_order_relaxed)) + "\n";
+        ret += "worker_busy_microseconds_total" + label + std::to_string(w.busyMicros.load(std::memory_order_relaxed)) + "\n";
+        accepted += w.accepted.load(std::memory_order_relaxed);
+        active += w.active.load(std::memory_order_relaxed);
+        requests += w.requests.load(std::memory_order_relaxed);
+        bytes += w.bytesSent.load(std::memory_order_relaxed);
+    }
+    ret += "server_connections_accepted_total " + std::to_string(accepted) + "\n";
+    ret += "server_connections_active " + std::to_string(active) + "\n";
+    ret += "server_requests_total " + std::to_string(requests) + "\n";
+    ret += "server_bytes_sent_total " + std::to_string(bytes) + "\n";
+    return ret;
+}
+
+// 存活的工作进程的平均连接数
+int64_t StatsSegment::getMeanActive() const {
+    int64_t sum = 0;
+    int64_t n = 0;
+    for (uint32_t i = 0; i < workers; ++i){
+        if (slots[i].pid.load(std::memory_order_relaxed) <= 0)
+            continue;
+        sum += slots[i].active.load(std::memory_order_relaxed);
+        ++n;
+    }
+    return n == 0 ? 0 : sum / n;
+}
+
+// 连接数最少的存活工作进程
+// @param except 排除的槽位（调用者自己）
+// @return 槽位，没有其他工作进程时返回 -1
+int32_t StatsSegment::getLeastLoaded(uint32_t except) const {
+    int32_t best = -1;
+    int64_t bestActive = 0;
+    for (uint32_t i = 0; i < workers; ++i){
+        if (i == except || slots[i].pid.load(std::memory_order_relaxed) <= 0)
+            continue;
+        int64_t active = slots[i].active.load(std::memory_order_relaxed);
+        if (best == -1 || active < bestActive){
+            best = i;
+            bestActive = active;
+        }
+    }
+    return best;
+}
+
+// master 构造函数
+// 映射计数器共享内存，fork 出的工作进程继承同一映射
+// @param n 工作进程数，超过 MASTER_MAX_WORKERS 时截断
+Master::Master(uint32_t n): workers(std::min(n, MASTER_MAX_WORKERS)){
+    void* mem = mmap(nullptr, sizeof(StatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED){
+        std::cout << "Could not map the worker stats segment: " << strerror(errno) << std::endl;
+    } else {
+        stats = new (mem) StatsSegment();
+        stats->workers = workers;
+        // 各工作进程迁移连接的收件箱，master 持有两端，工作进程重启后收件箱中的连接不会丢失
+        for (uint32_t i = 0; i < workers && workers > 1; ++i){
+            int32_t sv[2];
+            if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) != 0)
+                continue;
+            for (int32_t fd : sv){
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+            stats->slots[i].inbox = sv[0];
+            stats->slots[i].outbox = sv[1];
+        }
+    }
+    pids.assign(workers, -1);
+    startedAt.resize(workers);
+}
+
+// master 析构函数
+Master::~Master(){
+    if (stats != nullptr){
+        for (uint32_t i = 0; i < workers; ++i){
+            if (stats->slots[i].inbox != -1)
+                close(stats->slots[i].inbox);
+            if (stats->slots[i].outbox != -1)
+                close(stats->slots[i].outbox);
+        }
+        stats->~StatsSegment();
+        munmap(stats, sizeof(StatsSegment));
+    }
+    if (listenSocket != -1)
+        close(listenSocket);
+}
+
+// 创建工作进程共享的监听套接字
+// 绑定端口后按需降权，工作进程继承降权后的身份
+// @param port 监听端口
+// @param dropUid bind() 之后切换到的 uid，为 0 时忽略
+// @param dropGid bind() 之后切换到的 gid，为 0 时忽略
+// @param profile 监听套接字的选项
+// @return 失败时返回 false
+bool Master::listen(int32_t port, int32_t dropUid, int32_t dropGid, SocketProfile const& profile){
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == -1){
+        std::cout << "Could not create socket" << std::endl;
+        return false;
+    }
+    // 非阻塞：多个工作进程同时被唤醒时，没抢到连接的 accept() 立即返回
+    fcntl(listenSocket, F_SETFL, O_NONBLOCK);
+    int32_t on = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(listenSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+        std::cout << "Failed to bind to the address" << std::endl;
+        return false;
+    }
+    if (dropUid > 0 && dropGid > 0){
+        if (setgid(dropGid) != 0 || setuid(dropUid) != 0){
+            std::cout << "Dropping to uid " << dropUid << " / gid " << dropGid << " failed!" << std::endl;
+            return false;
+        }
+        std::cout << "Successfully dropped uid to " << dropUid << " and gid to " << dropGid << std::endl;
+    }
+    profile.applyListener(listenSocket);
+    if (::listen(listenSocket, profile.backlog) != 0){
+        std::cout << "Failed to put the socket in a listening state" << std::endl;
+        return false;
+    }
+    std::cout << "Master listening on port " << port << " with " << workers << " workers" << std::endl;
+    return true;
+}
+
+// fork 一个工作进程
+// 子进程恢复默认信号处置、绑定到一个 CPU，然后运行 workerMain，不返回
+// SIGHUP/SIGUSR2 在子进程中保持屏蔽，直到工作进程安装好处理函数后调用 releaseWorkerSignals()：
+// 这期间 master 转发的重新加载信号保持挂起，既不会按默认处置杀死工作进程，也不会丢失
+// @param slot 槽位
+// @return 子进程 pid，失败时返回 -1
+pid_t Master::spawn(uint32_t slot){
+    pid_t pid = fork();
+    if (pid < 0){
+        std::cout << "fork failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    if (pid == 0){
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGHUP, SIG_DFL);
+        signal(SIGUSR2, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        sigset_t mask = origMask;
+        sigaddset(&mask, SIGHUP);
+        sigaddset(&mask, SIGUSR2);
+        sigprocmask(SIG_SETMASK, &mask, nullptr);
+#ifdef __linux__
+        // 按槽位绑定 CPU，工作进程的缓存和连接都留在同一个核上
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpu > 0){
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(slot % ncpu, &set);
+            if (sched_setaffinity(0, sizeof(set), &set) != 0)
+                std::cout << "Could not pin worker " << slot << " to CPU " << slot % ncpu << std::endl;
+        }
+#endif
+        _exit(workerMain(slot));
+    }
+
+    pids[slot] = pid;
+    startedAt[slot] = std::chrono::steady_clock::now();
+    if (stats != nullptr){
+        stats->slots[slot].pid.store(pid, std::memory_order_relaxed);
+        stats->slots[slot].active.store(0, std::memory_order_relaxed);
+    }
+    std::cout << "Worker " << slot << " started as pid " << pid << std::endl;
+    return pid;
+}
+
+// 放开 spawn() 为工作进程保留屏蔽的 SIGHUP/SIGUSR2，挂起的信号随即递送
+// 由工作进程在安装好这两个信号的处理函数、并且处理函数可以使用之后调用
+void Master::releaseWorkerSignals(){
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR2);
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+}
+
+// 根据 pid 查找槽位
+// @return 槽位，不是工作进程时返回 -1
+int32_t Master::findSlot(pid_t pid) const {
+    for (uint32_t i = 0; i < workers; ++i){
+        if (pids[i] == pid)
+            return i;
+    }
+    return -1;
+}
+
+// 向所有存活的工作进程发送信号
+void Master::signalWorkers(int32_t sig){
+    for (pid_t pid : pids){
+        if (pid > 0)
+            kill(pid, sig);
+    }
+}
+
+// 运行 master
+// 启动所有工作进程，工作进程一退出就在同一个槽位上重启它。
+// 关心的信号平时被屏蔽，只在 sigsuspend() 中放开，避免检查标志和等待之间丢失信号
+// SIGUSR2 不停机升级需要重新执行整个进程树，prefork 模式不支持：master 收到后只记录日志，不转发也不退出
+// @param main 工作进程的入口，参数为槽位，返回值作为进程退出码
+// @return master 的退出码
+int32_t Master::run(std::function<int32_t(uint32_t)> main){
+    workerMain = std::move(main);
+
+    sigset_t block;
+    sigemptyset(&block);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGHUP);
+    sigaddset(&block, SIGUSR2);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &origMask);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = handleMasterStop;
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+    sa.sa_handler = handleMasterReload;
+    sigaction(SIGHUP, &sa, nullptr);
+    sa.sa_handler = handleMasterUpgrade;
+    sigaction(SIGUSR2, &sa, nullptr);
+    sa.sa_handler = handleMasterChild;
+    sigaction(SIGCHLD, &sa, nullptr);
+
+    for (uint32_t i = 0; i < workers; ++i)
+        spawn(i);
+
+    bool stopping = false;
+    uint32_t alive = std::count_if(pids.begin(), pids.end(), [](pid_t pid){ return pid > 0; });
+    while (alive > 0){
+        if (g_masterStop && !stopping){
+            std::cout << "Master stopping workers" << std::endl;
+            stopping = true;
+            signalWorkers(SIGTERM);
+        }
+        if (g_masterReload){
+            g_masterReload = 0;
+            signalWorkers(SIGHUP);
+        }
+        if (g_masterUpgrade){
+            g_masterUpgrade = 0;
+            std::cout << "SIGUSR2 ignored: upgrades are not supported with workers, restart the master instead" << std::endl;
+        }
+
+        // 回收所有已退出的工作进程并立即重启
+        int32_t status = 0;
+        pid_t pid;
+        bool reaped = false;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0){
+            int32_t slot = findSlot(pid);
+            if (slot < 0)
+                continue;
+            reaped = true;
+            pids[slot] = -1;
+            --alive;
+            if (stopping)
+                continue;
+
+            if (WIFSIGNALED(status))
+                std::cout << "Worker " << slot << " (pid " << pid << ") killed by signal " << WTERMSIG(status) << std::endl;
+            else
+                std::cout << "Worker " << slot << " (pid " << pid << ") exited with status " << WEXITSTATUS(status) << std::endl;
+
+            // 刚启动就退出（配置错误等）时稍作等待，否则立即重启
+            auto uptime = std::chrono::steady_clock::now() - startedAt[slot];
+            if (uptime < std::chrono::milliseconds(WORKER_MIN_UPTIME_MS))
+                std::this_thread::sleep_for(std::chrono::milliseconds(WORKER_RESPAWN_DELAY_MS));
+            if (stats != nullptr)
+                stats->slots[slot].restarts.fetch_add(1, std::memory_order_relaxed);
+            if (spawn(slot) > 0)
+                ++alive;
+        }
+        if (!reaped && alive > 0)
+            sigsuspend(&origMask);
+    }
+    sigprocmask(SIG_SETMASK, &origMask, nullptr);
+    std::cout << "Master exiting" << std::endl;
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "MemoryController.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 从头读取已打开的 procfs / cgroup 文件（每次从偏移 0 读取都会得到最新内容）
+// @param fd 文件描述符
+// @param buf 缓冲区，读取的内容以 NUL 结尾
+// @param len 缓冲区大小
+// @return 读取失败或文件为空时返回 false
+static bool readWhole(int32_t fd, char* buf, size_t len){
+    if (fd == -1)
+        return false;
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    if (n <= 0)
+        return false;
+    buf[n] = '\0';
+    return true;
+}
+
+// 读取只有一个数字（或 "max"）的 cgroup 文件
+// @return 数值，"max" 或读取失败时返回 0
+static uint64_t readCgroupValue(int32_t fd){
+    char buf[32];
+    if (!readWhole(fd, buf, sizeof(buf)) || strncmp(buf, "max", 3) == 0)
+        return 0;
+    return strtoull(buf, nullptr, 10);
+}
+
+// 定位本进程的 cgroup v2 目录，并以 memory.max 的一半作为初始预算的参考
+// @param minBytes 预算下限
+// @param maxBytes 预算上限
+MemoryController::MemoryController(uint64_t minBytes, uint64_t maxBytes) :
+    configMin(minBytes), configMax(std::max(minBytes, maxBytes)),
+    minBudget(minBytes), maxBudget(std::max(minBytes, maxBytes)), budget(minBytes){
+    // cgroup v2 下 /proc/self/cgroup 只有一行 "0::/<path>"
+    std::ifstream cg("/proc/self/cgroup");
+    std::string line;
+    while (getline(cg, line)){
+        if (line.starts_with("0::")){
+            std::string dir = "/sys/fs/cgroup" + line.substr(3);
+            cgroupCurrentFd = open((dir + "/memory.current").c_str(), O_RDONLY | O_CLOEXEC);
+            if (cgroupCurrentFd != -1){
+                cgroupDir = dir;
+                cgroupMaxFd = open((dir + "/memory.max").c_str(), O_RDONLY | O_CLOEXEC);
+            }
+            break;
+        }
+    }
+    psiFd = open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+
+    sample();
+    // 有 cgroup 限制时，预算上限不超过限制的一半
+    if (cgroupMax > 0)
+        maxBudget = std::max(minBudget, std::min(maxBudget, cgroupMax / 2));
+    budget = std::clamp<uint64_t>(maxBudget / 4, minBudget, maxBudget);
+}
+
+MemoryController::~MemoryController(){
+    for (int32_t fd : {psiFd, cgroupMaxFd, cgroupCurrentFd}){
+        if (fd != -1)
+            close(fd);
+    }
+}
+
+// 修改预算上下限（重新加载配置时）
+// 保留当前预算（收进新的范围）和决策计数，上下限没有变化时什么也不做
+// @param minBytes 预算下限
+// @param maxBytes 预算上限
+// @return 上下限发生变化时返回 true，调用者应把新预算分配给各缓存
+bool MemoryController::setLimits(uint64_t minBytes, uint64_t maxBytes){
+    maxBytes = std::max(minBytes, maxBytes);
+    if (minBytes == configMin && maxBytes == configMax)
+        return false;
+    configMin = minBytes;
+    configMax = maxBytes;
+    minBudget = minBytes;
+    maxBudget = maxBytes;
+    if (cgroupMax > 0)
+        maxBudget = std::max(minBudget, std::min(maxBudget, cgroupMax / 2));
+    budget = std::clamp(budget, minBudget, maxBudget);
+    return true;
+}
+
+// 读取 PSI 和 cgroup 用量
+void MemoryController::sample(){
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    // full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    char buf[256];
+    psiAvailable = false;
+    if (readWhole(psiFd, buf, sizeof(buf))){
+        double avg10 = 0.0;
+        if (sscanf(buf, "some avg10=%lf", &avg10) == 1){
+            someAvg10 = avg10;
+            psiAvailable = true;
+        }
+        if (char const* full = strstr(buf, "full avg10="); full != nullptr && sscanf(full, "full avg10=%lf", &avg10) == 1)
+            fullAvg10 = avg10;
+    }
+
+    if (!cgroupDir.empty()){
+        cgroupMax = readCgroupValue(cgroupMaxFd);
+        cgroupCurrent = readCgroupValue(cgroupCurrentFd);
+    }
+}
+
+// 采样并调整预算，每秒最多执行一次
+// @param now 当前时间
+// @return 预算发生变化时返回 true，调用者应把新预算分配给各缓存
+bool MemoryController::tick(time_t now){
+    if (now == lastTick)
+        return false;
+    lastTick = now;
+    sample();
+
+    bool overLimit = cgroupMax > 0 && cgroupCurrent > cgroupMax * MEMCTL_USAGE_HIGH;
+    bool pressured = psiAvailable && someAvg10 > MEMCTL_PRESSURE_HIGH;
+    uint64_t old = budget;
+
+    if (overLimit || pressured){
+        // 乘性收缩：每次减少 1/4
+        budget = std::max(minBudget, budget - budget / 4);
+        if (budget != old){
+            ++shrinkCount;
+            std::cout << "Memory pressure (some avg10=" << someAvg10 << ", current=" << cgroupCurrent
+                      << ", max=" << cgroupMax << "): cache budget " << old << " -> " << budget << std::endl;
+        }
+    } else if (!psiAvailable || someAvg10 < MEMCTL_PRESSURE_LOW){
+        // 加性增长：每次增加下限大小，且增长后的用量仍需低于 memory.max 的 MEMCTL_USAGE_LOW
+        uint64_t step = minBudget;
+        bool room = cgroupMax == 0 || cgroupCurrent + step < cgroupMax * MEMCTL_USAGE_LOW;
+        if (room)
+            budget = std::min(maxBudget, budget + step);
+        if (budget != old)
+            ++growCount;
+    }
+    return budget != old;
+}
+
+// 导出当前的采样值、预算和决策计数（Prometheus 文本格式）
+std::string MemoryController::getMetrics() const {
+    std::string ret;
+    ret += "memctl_psi_some_avg10 " + std::to_string(someAvg10) + "\n";
+    ret += "memctl_psi_full_avg10 " + std::to_string(fullAvg10) + "\n";
+    ret += "memctl_cgroup_max_bytes " + std::to_string(cgroupMax) + "\n";
+    ret += "memctl_cgroup_current_bytes " + std::to_string(cgroupCurrent) + "\n";
+    ret += "memctl_cache_budget_bytes " + std::to_string(budget) + "\n";
+    ret += "memctl_shrink_total " + std::to_string(shrinkCount) + "\n";
+    ret += "memctl_grow_total " + std::to_string(growCount) + "\n";
+    return ret;
+}
@@ -0,0 +1,75 @@
+#include "MemoryStorage.h"
+#include "DiskStorage.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// 将 docroot 整体读入内存
+// 借助 DiskStorage 读取，因此隐藏文件、目录索引和 MIME 类型的规则与磁盘后端一致
+// @param base docroot 的磁盘路径
+MemoryStorage::MemoryStorage(std::string const& base) : baseDiskPath(base){
+    DiskStorage disk(baseDiskPath);
+    std::error_code ec;
+    auto root = std::filesystem::path(baseDiskPath);
+
+    // docroot 本身
+    if (auto res = disk.load("/"); res != nullptr){
+        totalBytes += res->getSize();
+        resources.try_emplace("/", std::move(res));
+    }
+
+    for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(ec)){
+        if (ec)
+            break;
+        std::string name = it->path().filename().string();
+        // 跳过隐藏文件和目录
+        if (name.starts_with(".")){
+            if (it->is_directory(ec))
+                it.disable_recursion_pending();
+            continue;
+        }
+
+        std::string uri = "/" + std::filesystem::relative(it->path(), root, ec).generic_string();
+        bool dir = it->is_directory(ec);
+        if (dir)
+            uri += "/";
+        auto res = disk.load(uri);
+        if (res == nullptr)
+            continue;
+        totalBytes += res->getSize();
+        std::shared_ptr<Resource> shared = std::move(res);
+        resources.try_emplace(uri, shared);
+        // 目录同时登记不带结尾 / 的形式
+        if (dir)
+            resources.try_emplace(uri.substr(0, uri.length() - 1), shared);
+    }
+
+    std::cout << "Loaded " << resources.size() << " resources (" << totalBytes << " bytes) from "
+              << baseDiskPath << " into memory" << std::endl;
+}
+
+// 从内存中查找资源
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @return 资源对象，不存在时返回 NULL
+std::shared_ptr<Resource> MemoryStorage::lookup(std::string const& requestUri, [[maybe_unused]] bool acceptGzip){
+    auto it = resources.find(requestUri.substr(0, requestUri.find('?')));
+    if (it == resources.end())
+        return nullptr;
+    return it->second;
+}
+
+// 返回资源的一份独立拷贝
+std::unique_ptr<Resource> MemoryStorage::load(std::string const& requestUri){
+    auto shared = lookup(requestUri, false);
+    if (shared == nullptr)
+        return nullptr;
+    auto res = std::make_unique<Resource>(shared->getLocation(), shared->isDirectory());
+    res->setMimeType(shared->getMimeType());
+    auto data = new uint8_t[shared->getSize()];
+    memcpy(data, shared->getData(), shared->getSize());
+    res->setData(data, shared->getSize());
+    return res;
+}
@@ -0,0 +1,105 @@
+#include "PackFile.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PackFile::~PackFile(){
+    if (base != nullptr){
+        munmap((void*)base, mapLen);
+        base = nullptr;
+    }
+}
+
+// FNV-1a 64 位哈希，必须与 build_pack.py 中的实现一致
+uint64_t PackFile::hashUri(std::string_view uri){
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : uri){
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// 映射资源包文件
+// @param path 资源包的磁盘路径
+// @return 成功映射且格式有效时返回 true
+bool PackFile::open(std::string const& path){
+    int32_t fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    struct stat sb = {};
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(PackHeader)){
+        close(fd);
+        return false;
+    }
+    mapLen = sb.st_size;
+    void* m = mmap(nullptr, mapLen, PROT_READ, MAP_SHARED, fd, 0);
+    // 映射建立后描述符就不再需要
+    close(fd);
+    if (m == MAP_FAILED){
+        mapLen = 0;
+        return false;
+    }
+    base = (const uint8_t*)m;
+    header = (const PackHeader*)base;
+
+    // 只检查头部，不读入索引：页面在查找时按需调入，打开的耗时与条目数无关
+    if (!validate()){
+        munmap(m, mapLen);
+        base = nullptr;
+        header = nullptr;
+        mapLen = 0;
+        return false;
+    }
+    buckets = (const PackEntry*)(base + header->indexOffset);
+    return true;
+}
+
+// 区域 [off, off + len) 是否落在映射范围内（不会溢出）
+bool PackFile::inBounds(uint64_t off, uint64_t len) const {
+    return off <= mapLen && len <= mapLen - off;
+}
+
+// 检查头部以及索引区、字符串区是否都落在映射范围内
+// 条目指向的字符串和正文在 find() 中逐个检查
+bool PackFile::validate() const {
+    if (memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header->version != PACK_VERSION)
+        return false;
+    if (header->bucketCount == 0 || (header->bucketCount & (header->bucketCount - 1)) != 0)
+        return false;
+    if (!inBounds(header->indexOffset, (uint64_t)header->bucketCount * sizeof(PackEntry)))
+        return false;
+    if (header->indexOffset % alignof(PackEntry) != 0)
+        return false;
+    return inBounds(header->stringsOffset, header->stringsSize);
+}
+
+// 检查条目引用的字符串和正文是否都落在映射范围内
+bool PackFile::validEntry(const PackEntry& e) const {
+    return inBounds(e.uriOffset, e.uriLen) && inBounds(e.mimeOffset, e.mimeLen) && inBounds(e.etagOffset, e.etagLen) &&
+           inBounds(e.bodyOffset, e.bodyLen) && inBounds(e.gzipOffset, e.gzipLen);
+}
+
+// 查找 URI 对应的条目
+// 只检查探测到的条目，越界的条目视为不存在
+// @param uri 不含查询字符串的 URI
+// @return 条目指针，不存在时返回 NULL
+const PackEntry* PackFile::find(std::string_view uri) const {
+    if (header == nullptr)
+        return nullptr;
+    uint64_t h = hashUri(uri);
+    uint32_t mask = header->bucketCount - 1;
+    for (uint32_t i = h & mask, n = 0; n < header->bucketCount; i = (i + 1) & mask, ++n){
+        const PackEntry& e = buckets[i];
+        if (e.uriLen == 0)
+            return nullptr;
+        if (e.hash != h || !inBounds(e.uriOffset, e.uriLen))
+            continue;
+        if (getString(e.uriOffset, e.uriLen) == uri)
+            return validEntry(e) ? &e : nullptr;
+    }
+    return nullptr;
+}
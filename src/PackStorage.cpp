@@ -0,0 +1,53 @@
+#include "PackStorage.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// 映射资源包
+// @param path 由 build_pack.py 生成的 .pack 文件路径
+PackStorage::PackStorage(std::string const& path) : packPath(path), pack(std::make_shared<PackFile>()){
+    mapped = pack->open(packPath);
+    if (mapped)
+        std::cout << "Serving " << pack->getEntryCount() << " packed resources from " << packPath << std::endl;
+    else
+        std::cout << "Could not map resource pack " << packPath << std::endl;
+}
+
+// 从资源包中获取资源
+// 资源直接引用映射的内存并共享映射的所有权，只有一次哈希探测，不产生系统调用
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @param acceptGzip 客户端是否接受 gzip 编码，接受且存在预压缩版本时返回压缩的正文
+// @return 资源对象，不存在时返回 NULL
+std::shared_ptr<Resource> PackStorage::lookup(std::string const& requestUri, bool acceptGzip){
+    if (!mapped)
+        return nullptr;
+    std::string_view uri = requestUri;
+    uri = uri.substr(0, uri.find('?'));
+    const PackEntry* e = pack->find(uri);
+    if (e == nullptr)
+        return nullptr;
+
+    auto res = std::make_shared<Resource>(std::string(uri));
+    res->setMimeType(pack->getString(e->mimeOffset, e->mimeLen));
+    res->setEtag(pack->getString(e->etagOffset, e->etagLen));
+    if (acceptGzip && e->gzipLen > 0){
+        res->setExternalData(pack->getBytes(e->gzipOffset), e->gzipLen, pack);
+        res->setContentEncoding("gzip");
+    } else {
+        res->setExternalData(pack->getBytes(e->bodyOffset), e->bodyLen, pack);
+    }
+    return res;
+}
+
+// 与 lookup() 相同（不使用预压缩版本），供需要独占资源对象的调用者使用
+std::unique_ptr<Resource> PackStorage::load(std::string const& requestUri){
+    auto shared = lookup(requestUri, false);
+    if (shared == nullptr)
+        return nullptr;
+    auto res = std::make_unique<Resource>(shared->getLocation());
+    res->setMimeType(shared->getMimeType());
+    res->setEtag(shared->getEtag());
+    res->setExternalData(shared->getData(), shared->getSize(), pack);
+    return res;
+}
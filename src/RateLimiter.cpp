@@ -0,0 +1,123 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+
+RateLimiter::~RateLimiter(){
+    if (slots != nullptr)
+        munmap(slots, mapped);
+}
+
+// 映射令牌桶表，须在 fork 工作进程之前调用，工作进程继承同一映射
+// @param capacity 最多跟踪的 IP 数，向上取整为 RATE_LIMIT_WAYS 乘以 2 的幂
+// @return 映射失败时返回 false
+bool RateLimiter::init(uint32_t capacity){
+    uint32_t groups = 1;
+    while (groups * RATE_LIMIT_WAYS < capacity && groups < (1u << 24))
+        groups <<= 1;
+    size_t len = (size_t)groups * RATE_LIMIT_WAYS * sizeof(RateBucket);
+    void* mem = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED){
+        std::cout << "Could not map the rate limit table: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // 匿名映射的内容为零：所有槽位为空
+    slots = new (mem) RateBucket[(size_t)groups * RATE_LIMIT_WAYS];
+    groupMask = groups - 1;
+    mapped = len;
+    return true;
+}
+
+// 设置速率
+// @param perSec 每个 IP 每秒允许的请求数，0 表示不限制
+// @param burstSize 允许的突发请求数，0 表示与 perSec 相同
+void RateLimiter::setRate(uint32_t perSec, uint32_t burstSize){
+    ratePerSec = perSec;
+    burst = std::min<uint32_t>(burstSize > 0 ? burstSize : perSec, 1000000);
+}
+
+static uint64_t packState(uint64_t tokens, uint32_t ms){
+    return tokens << 32 | ms;
+}
+
+// 消耗 addr 的一个令牌
+// 不在表中的 IP 以满桶加入，组满时替换组内最久未访问的 IP
+// 时间只保存低 32 位，按回绕差值计算间隔；超过约 49 天未访问的 IP 可能少补充令牌
+// @param addr IPv4 地址（网络字节序）
+// @param nowMs 当前时间（单调时钟，毫秒）
+// @return 令牌不足时返回 false
+bool RateLimiter::allow(uint32_t addr, uint64_t nowMs){
+    if (!isEnabled() || addr == 0)
+        return true;
+
+    uint32_t now = (uint32_t)nowMs;
+    uint64_t full = (uint64_t)burst * 1000;
+    uint32_t group = (uint32_t)(((uint64_t)addr * 0x9E3779B97F4A7C15ULL) >> 32) & groupMask;
+    RateBucket* set = slots + (size_t)group * RATE_LIMIT_WAYS;
+
+    for (uint32_t attempt = 0; attempt < RATE_LIMIT_CLAIM_RETRIES; ++attempt){
+        RateBucket* bucket = nullptr;
+        RateBucket* victim = nullptr;
+        uint32_t victimAddr = 0;
+        uint32_t victimAge = 0;
+        for (uint32_t i = 0; i < RATE_LIMIT_WAYS; ++i){
+            uint32_t a = set[i].addr.load(std::memory_order_acquire);
+            if (a == addr){
+                bucket = &set[i];
+                break;
+            }
+            // 优先使用空槽位，否则淘汰最久未访问的
+            if (victim != nullptr && victimAddr == 0)
+                continue;
+            uint32_t age = now - (uint32_t)set[i].state.load(std::memory_order_relaxed);
+            if (victim == nullptr || a == 0 || age > victimAge){
+                victim = &set[i];
+                victimAddr = a;
+                victimAge = age;
+            }
+        }
+
+        if (bucket == nullptr){
+            // 抢占槽位；其他进程同时抢占或写入了同一个 IP 时重新查找
+            if (!victim->addr.compare_exchange_strong(victimAddr, addr, std::memory_order_acq_rel))
+                continue;
+            if (victimAddr != 0)
+                ++evicted;
+            victim->state.store(packState(full - 1000, now), std::memory_order_release);
+            return true;
+        }
+
+        uint64_t old = bucket->state.load(std::memory_order_acquire);
+        uint64_t next;
+        bool ok;
+        do {
+            // 惰性补充：距上次访问每毫秒补充 ratePerSec / 1000 个令牌；
+            // 其他进程已写入更晚的时间时不补充，也不把时间往回改
+            uint32_t last = (uint32_t)old;
+            int32_t elapsed = (int32_t)(now - last);
+            uint64_t tokens = std::min(full, (old >> 32) + (uint64_t)std::max(elapsed, 0) * ratePerSec);
+            ok = tokens >= 1000;
+            if (ok)
+                tokens -= 1000;
+            next = packState(tokens, elapsed > 0 ? now : last);
+        } while (!bucket->state.compare_exchange_weak(old, next, std::memory_order_acq_rel));
+        if (!ok)
+            ++limited;
+        return ok;
+    }
+    // 组内竞争激烈，放行而不是阻塞
+    return true;
+}
+
+// 导出限速指标
+std::string RateLimiter::getMetrics() const {
+    std::string ret;
+    ret += "rate_limited_total " + std::to_string(limited) + "\n";
+    ret += "rate_limit_evicted_total " + std::to_string(evicted) + "\n";
+    ret += "rate_limit_table_slots " + std::to_string(slots != nullptr ? (uint64_t)(groupMask + 1) * RATE_LIMIT_WAYS : 0) + "\n";
+    return ret;
+}
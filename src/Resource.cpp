@@ -1,12 +1,47 @@
 #include "Resource.h"
+#include "ResourceArena.h"
 
+#include<cstring>
 #include<string>
 
 Resource::Resource(std::string const& loc, bool dir) : kicaruib(loc), directory(dir){}
 
 Resource::~Resource(){
-    if (data != nullptr){
+    if (data != nullptr && arena != nullptr){
+        arena->release(data, size);
+        data = nullptr;
+    } else if (data != nullptr && ownsData){
         delete[] data;
         data = nullptr;
     }
-}
\ No newline at end of file
+}
+
+// 把正文复制到 arena 中并释放原来的内存
+// 只有自己持有内存的资源才会迁移，外部内存（资源包）保持不变
+// @param a 目标 arena
+// @return 迁移成功时返回 true
+bool Resource::moveToArena(std::shared_ptr<ResourceArena> const& a){
+    if (data == nullptr || !ownsData || arena != nullptr)
+        return false;
+    uint8_t* d = a->allocate(size);
+    if (d == nullptr)
+        return false;
+    memcpy(d, data, size);
+    delete[] data;
+    data = d;
+    arena = a;
+    return true;
+}
+
+// 正文所在的 arena 区域存活率过低时，把正文搬到当前区域
+// 调用者必须保证没有其他地方正在使用 getData() 返回的指针
+// @return 正文被搬移时返回 true
+bool Resource::compact(){
+    if (arena == nullptr || !arena->isSparse(data))
+        return false;
+    uint8_t* d = arena->relocate(data, size);
+    if (d == data)
+        return false;
+    data = d;
+    return true;
+}
@@ -0,0 +1,145 @@
+#include "ResourceArena.h"
+
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+
+ResourceArena::~ResourceArena(){
+    for (auto& r : regions)
+        munmap(r.base, r.size);
+    regions.clear();
+}
+
+// 映射一个新区域并设为当前区域
+// 先尝试显式大页（MAP_HUGETLB，需要预留的 hugetlbfs 页），失败时退回普通映射并建议内核使用透明大页
+// @return 映射失败时返回 false
+bool ResourceArena::mapRegion(){
+    Region r;
+    r.size = ARENA_REGION_SIZE;
+    void* m = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    m = mmap(nullptr, r.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    r.hugetlb = m != MAP_FAILED;
+#endif
+    if (m == MAP_FAILED){
+        m = mmap(nullptr, r.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED)
+            return false;
+#ifdef MADV_HUGEPAGE
+        madvise(m, r.size, MADV_HUGEPAGE);
+#endif
+    }
+    r.base = (uint8_t*)m;
+    if (r.hugetlb)
+        ++hugetlbRegions;
+    mappedBytes += r.size;
+    regions.push_back(r);
+    current = regions.size() - 1;
+    return true;
+}
+
+// 查找指针所属的区域
+ResourceArena::Region* ResourceArena::regionOf(const uint8_t* p){
+    for (auto& r : regions){
+        if (p >= r.base && p < r.base + r.size)
+            return &r;
+    }
+    return nullptr;
+}
+
+// 分配一块内存
+// 只在当前区域中递增分配；当前区域用完时优先重用完全空闲的区域，否则映射新区域
+// 存活率低的旧区域不会再被分配，只会逐渐被释放或整理
+// @param len 字节数
+// @return 内存指针，len 过大或映射失败时返回 NULL（调用者应改用普通分配）
+uint8_t* ResourceArena::allocate(size_t len){
+    if (len == 0 || len > ARENA_MAX_BLOCK)
+        return nullptr;
+    size_t need = (len + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    if (regions.empty() || regions[current].used + need > regions[current].size){
+        bool found = false;
+        for (size_t i = 0; i < regions.size(); ++i){
+            if (regions[i].live == 0){
+                regions[i].used = 0;
+                current = i;
+                found = true;
+                break;
+            }
+        }
+        if (!found && !mapRegion())
+            return nullptr;
+    }
+
+    Region& r = regions[current];
+    uint8_t* p = r.base + r.used;
+    r.used += need;
+    r.live += need;
+    liveBytes += need;
+    return p;
+}
+
+// 释放一块内存。区域完全空闲时，除当前区域和一个备用区域外都归还给操作系统
+// @param p allocate() 返回的指针
+// @param len 分配时的字节数
+void ResourceArena::release(uint8_t* p, size_t len){
+    Region* r = regionOf(p);
+    if (r == nullptr)
+        return;
+    size_t need = (len + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    r->live -= need;
+    liveBytes -= need;
+    if (r->live != 0)
+        return;
+
+    r->used = 0;
+    size_t idx = r - regions.data();
+    uint32_t empty = 0;
+    for (auto const& other : regions){
+        if (other.live == 0)
+            ++empty;
+    }
+    if (idx != current && empty > 1){
+        munmap(r->base, r->size);
+        mappedBytes -= r->size;
+        if (r->hugetlb)
+            --hugetlbRegions;
+        regions.erase(regions.begin() + idx);
+        if (current > idx)
+            --current;
+    }
+}
+
+// 指针所在的区域是否存活率过低、值得整理（当前区域除外）
+bool ResourceArena::isSparse(const uint8_t* p){
+    Region* r = regionOf(p);
+    if (r == nullptr || (size_t)(r - regions.data()) == current)
+        return false;
+    return r->live < r->used * ARENA_SPARSE_RATIO;
+}
+
+// 整理：把一块内存搬到当前区域，并释放原来的位置
+// 调用者必须保证没有其他地方持有旧指针
+// @param p 旧指针
+// @param len 字节数
+// @return 新指针，无法分配时返回原指针
+uint8_t* ResourceArena::relocate(uint8_t* p, size_t len){
+    uint8_t* np = allocate(len);
+    if (np == nullptr)
+        return p;
+    memcpy(np, p, len);
+    release(p, len);
+    relocatedBytes += len;
+    return np;
+}
+
+// 导出 arena 指标（Prometheus 文本格式）
+// @param label 指标标签，如 host="0"
+std::string ResourceArena::getMetrics(std::string const& label) const {
+    std::string ret;
+    ret += "arena_mapped_bytes{" + label + "} " + std::to_string(mappedBytes) + "\n";
+    ret += "arena_live_bytes{" + label + "} " + std::to_string(liveBytes) + "\n";
+    ret += "arena_hugetlb_regions{" + label + "} " + std::to_string(hugetlbRegions) + "\n";
+    ret += "arena_relocated_bytes_total{" + label + "} " + std::to_string(relocatedBytes) + "\n";
+    return ret;
+}
@@ -1,187 +1,201 @@
 #include "Resourcehost.h"
+#include "DiskStorage.h"
+#include "MemoryStorage.h"
+#include "PackStorage.h"
 
+#include <algorithm>
+#include <iostream>
 #include <memory>
-#include <sstream>
 #include <string>
-#include <fstream>
-#include <dirent.h>
-#include <sys/stat.h>
-#include <unistd.h>
-
-// 有效文件可用作目录索引
-const static std::vector<std::string> g_validIndexes = {
-    "index.html",
-    "index.htm",
-};
-
-// 将文件扩展名与其MIME类型相关联的字典
-const static std::unordered_map<std::string, std::string, std::hash<std::string>, std::equal_to<>> g_mimeMap = {
-#include "MimeTypes.inc"
-};
-
-ResourceHost::ResourceHost(std::string const& base) : baseDiskPath(base){
-    // TODO: 检查 baseDiskPath 是否是有效路径
+
+// 创建资源主机
+// @param base 后端的路径（disk/memory 为 docroot 目录，pack 为资源包文件）
+// @param storageType 存储后端："disk"（默认）、"memory" 或 "pack"
+ResourceHost::ResourceHost(std::string const& base, std::string const& storageType) :
+    arena(std::make_shared<ResourceArena>()){
+    // 以 .pack 结尾的路径总是作为资源包映射
+    if (storageType == "pack" || base.ends_with(".pack")){
+        storage = std::make_unique<PackStorage>(base);
+    } else if (storageType == "memory"){
+        storage = std::make_unique<MemoryStorage>(base);
+    } else {
+        if (storageType != "disk")
+            std::cout << "Unknown storage type " << storageType << ", using disk" << std::endl;
+        storage = std::make_unique<DiskStorage>(base);
+    }
 }
 
-// 在字典中查找 MIME 类型
-// @param ext 用于查找的文件扩展名
-// @return MIME 类型，作为字符串。如果未找到类型，则返回空字符串
-std::string ResourceHost::lookupMimeType(std::string const& ext) const{
-    auto it = g_mimeMap.find(ext);
-    if (it == g_mimeMap.end())
-        return "";
-    
-    return it->second;
+// 从内容缓存中删除一项
+void ResourceHost::eraseContent(std::unordered_map<std::string, ContentEntry>::iterator it){
+    contentBytes -= it->second.res->getSize();
+    contentLru.erase(it->second.lru);
+    contentCache.erase(it);
 }
 
-// 读取文件
-// 从磁盘读取文件并返回相应的资源对象
-// 这将创建一个新的资源对象--如果返回值不是空值，调用者应将其处理掉
-// @param path 文件的完整磁盘路径
-// @param sb 填充 stat 结构
-// 成功加载后返回资源对象
-std::unique_ptr<Resource> ResourceHost::readFile(std::string const& path, struct stat const& sb){
-    // 确保webserver User 拥有文件
-    if (!(sb.st_mode & S_SIRWXU))
-        return nullptr;
-    // 创建新资源对象并设置内容
-    auto res = std::make_unique<Resource>(path);
-    std::string name = res->getName();
-    if (name.length() == 0)
+// 从内容缓存中查找资源
+// 不访问存储后端：距上次确认超过 CONTENT_CACHE_REVALIDATE 的条目仍然返回，由调用者发起后台确认
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @param stale 输出条目是否需要重新确认；为 NULL 时需要重新确认的条目视为未命中
+// @return 缓存的资源，未命中时返回 NULL
+std::shared_ptr<Resource> ResourceHost::getCachedResource(std::string const& requestUri, bool* stale){
+    std::string uri = requestUri.substr(0, requestUri.find('?'));
+    auto it = contentCache.find(uri);
+    if (it == contentCache.end())
         return nullptr;
-    
-    // 始终禁止隐藏文件
-    if (name.starts_with(".")) {
+    bool expired = time(nullptr) >= it->second.validUntil;
+    if (stale != nullptr)
+        *stale = expired;
+    else if (expired)
         return nullptr;
-    }
-    std::ifstream file;
-    uint32_t len = 0;
-    
-    // 打开文件
-    file.open(path, std::ios::binary);
-
-    // 如果文件打开失败，返回空
-    if (!file.is_open())
-        return nullptr;
-    
-    // 获取文件大小
-    len = sb.st_size;
-
-    // 为文件内容分配 memory 并读取内容
-    auto fdata = new uint8_t[len];
-    memset(fdata, 0x00,len);
-    file.read((char*)fdata, len);
-
-    // 关闭文件
-    file.close();
 
-    if (auto mimetype = lookupMimeType(res->getExtension());mimetype.length() != 0){
-        res->setMimeType(mimetype);
-    }
-    else{
-        res->setMimeType("application/octet-stream");
-    }
+    // 移到 LRU 链表头部
+    contentLru.splice(contentLru.begin(), contentLru, it->second.lru);
+    return it->second.res;
+}
 
-    res->setData(fdata, len);
-    return res;
+// 取出需要重新确认的缓存资源，交给加载任务在 I/O 线程上调用 isFresh()
+// 仍然一致时加载任务直接返回它，不再读取文件
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @return 缓存的资源，不在缓存中时返回 NULL
+std::shared_ptr<Resource> ResourceHost::getExpiredResource(std::string const& requestUri){
+    auto it = contentCache.find(requestUri.substr(0, requestUri.find('?')));
+    return it == contentCache.end() ? nullptr : it->second.res;
 }
 
-// 读取目录
-// 从磁盘读取目录（列表或索引）到资源对象中
-// 这将创建一个新的资源对象--如果返回值不是空值，调用者应将其处理掉
-// @param path 文件的完整磁盘路径
-// @param sb 填充 stat 结构
-// 成功加载后返回资源对象
-std::unique_ptr<Resource> ResourceHost::readDirectory(std::string path, struct stat const& sb){
-    // 如果路径末尾没有 /，则以 / 结尾（以保持一致)
-    if (path.empty() || path[path.length() - 1] != '/')
-        path += "/";
-    // 探测有效索引
-    uint32_t numIndexes = std::size(g_validIndexes);
-    std::string loadIndex;
-    struct stat sidx = {0};
-    for (uint32_t i = 0; i < numIndexed; ++i){
-        loadIndex = path + g_validIndexes[i];
-        // 找到合适的索引文件加载并返回客户端
-        if (stat(loadIndex.c_str(), &sidx) == 0)
-            return readFile(loadIndex, sidx);
+// 将加载完成的文件放入内容缓存，超出容量时淘汰最久未使用的条目
+// 正文被复制到大页 arena 中；此时等待者尚未被通知，没有其他地方在使用原来的指针
+// 目录列表依赖查询字符串，不进入内容缓存
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @param res 已加载的资源，为 NULL 时（文件已不存在）只删除旧的条目
+void ResourceHost::cacheResource(std::string const& requestUri, std::shared_ptr<Resource> res){
+    std::string uri = requestUri.substr(0, requestUri.find('?'));
+    if (auto it = contentCache.find(uri); it != contentCache.end()){
+        // 重新确认的结果就是缓存中的资源：只延长有效期
+        if (it->second.res == res){
+            it->second.validUntil = time(nullptr) + CONTENT_CACHE_REVALIDATE;
+            return;
+        }
+        eraseContent(it);
     }
-    // 确保网络服务器 USER 拥有该目录
-    if (!(sb.st_mode & S_IRWXU))
-        return nullptr;
-
-    // 生成 HTML 目录列表
-    std::string listing = generateDirList(path);
-
-    uint32_t slen = listing.length();
-    auto sdata = new uint8_t[slen];
-    memset(sdata, 0x00, slen);
-    strnpy((char*)sdata, listing.c_str(), slen);
+    if (res == nullptr || res->isDirectory() || res->getSize() > CONTENT_CACHE_MAX_OBJECT)
+        return;
+
+    while (!contentLru.empty() && contentBytes + res->getSize() > contentBudget)
+        eraseContent(contentCache.find(contentLru.back()));
+    if (contentBytes + res->getSize() > contentBudget)
+        return;
+
+    res->moveToArena(arena);
+    contentLru.push_front(uri);
+    contentBytes += res->getSize();
+    contentCache.try_emplace(uri, ContentEntry{std::move(res), contentLru.begin(), time(nullptr) + CONTENT_CACHE_REVALIDATE});
+}
 
-    auto res = std::make_unique<Resource>(path, true);
-    res->setMimeType("text/html");
-    res->setData(sdata, slen);
-    return res;
+// 调整内容缓存的容量，缩小时立即淘汰最久未使用的条目
+// @param bytes 新的容量（字节）
+void ResourceHost::setCacheBudget(uint64_t bytes){
+    contentBudget = bytes;
+    while (!contentLru.empty() && contentBytes > contentBudget)
+        eraseContent(contentCache.find(contentLru.back()));
 }
 
-// 返回由相对路径 dirPath 提供的 HTML 目录列表
-// @param path 文件的完整磁盘路径
-// @return 返回目录的 HTML 字符串表示。如果目录无效，则返回空白字符串
-std::string ResourceHost::generateDirList(std::string const& path) const {
-    // 从整个路径中删除开头的 baseDiskPath，只获取相对 uri
-    size_t uri_pos = path.find(baseDiskPath);
-    std::string uri = "?";
-    if (uri_pos != std::string::npos)
-        uri = path.substr(uri_pos + baseDiskPath.length());
-    std::stringstream ret;
-    ret << "<html><head><title>" << uri << "</title></head><body>";
-    const struct dirent* ent = nullptr;
-    DIR* dir = opendir(path.c_str());
-    if (dir == nullptr)
-        return "";
-    // 页面标题，显示所列目录的 URI
-    ret << "<h1>Index of " << uri << "</h1><hr /><br />";
-    // 将所有文件和目录添加到返回值中
-    while ((ent = readdir(dir)) != nullptr){
-        // 跳过隐藏文件 (以 . 开头)
-        if (ent->d_name[0] == '.')
+// 整理 arena：把位于稀疏区域、且只被缓存持有的正文搬到当前区域，使旧区域尽快完全空闲并被回收
+// 仍被响应或等待者引用的资源不会移动
+// @param maxBytes 本次最多搬移的字节数
+// @return 实际搬移的字节数
+uint64_t ResourceHost::compactCache(uint64_t maxBytes){
+    uint64_t moved = 0;
+    for (auto& [uri, entry] : contentCache){
+        if (moved >= maxBytes)
+            break;
+        if (entry.res.use_count() != 1)
             continue;
-        // 显示目录中对象的链接：
-        ret << "<a href=\"" << uri << ent->d_name << "\">" << ent->d_name << "</a><br />";
+        if (entry.res->compact())
+            moved += entry.res->getSize();
     }
+    return moved;
+}
 
-    closedir(dir);
-
-    ret << "</body></html>";
-    return ret.str();
+// 加入对 URI 的加载
+// 第一个调用者成为负责加载的一方，之后的调用者只挂在同一次加载的结果上
+// @param uri 请求中发送的 URI
+// @param waiter 加载完成后调用的回调
+// @return 调用者需要发起加载时返回 true，已有相同的加载在进行中时返回 false
+bool ResourceHost::joinLoad(std::string const& uri, std::function<void(std::shared_ptr<Resource>)> waiter){
+    auto [it, first] = inflight.try_emplace(uri);
+    it->second.push_back(std::move(waiter));
+    return first;
 }
 
-// 从文件系统读取资源
-// 返回一个新的资源对象--如果返回值不是空值，调用者应将其处理掉
+// 结束对 URI 的加载
+// 将结果放入内容缓存，然后依次通知所有等待者
 // @param uri 请求中发送的 URI
-// @reutn 如果无法加载资源，则返回 NULL
-std::unique_ptr<Resource> ResourceHost::getResource(std::string const& uri) {
-    if (uri.length() > 255 || uri.empty())
-        return nullptr;
+// @param res 加载结果，资源不存在时为 NULL
+void ResourceHost::finishLoad(std::string const& uri, std::shared_ptr<Resource> res){
+    cacheResource(uri, res);
+
+    auto it = inflight.find(uri);
+    if (it == inflight.end())
+        return;
+    // 先从表中取出，回调中可能再次对同一 URI 发起加载
+    auto waiters = std::move(it->second);
+    inflight.erase(it);
+    for (auto const& waiter : waiters)
+        waiter(res);
+}
 
-    // 不允许目录遍历
-    if (uri.contains("../") || uri.contains("/.."))
-        return nullptr;
-    
-    // 使用 stat 收集有关资源的信息：确定它是目录还是文件，检查它是否为组/用户所有，修改次数
-    std::string path = baseDiskPath + uri;
-    struct stat sb = {0};
-    if (stat(path.c_str(), &sb) != 0)
-        return nullptr;
-    
-    if (sb.st_mode & S_IFDIR){
-        // 从 FS 将目录列表或索引读入内存
-        return readDirectory(path, sb);
-    } else if (sb.st_mode & S_IFREG){
-        // 尝试从 FS 将文件加载到内存中
-        return readFile(path, sb);
-    } else {
+// 放弃所有进行中的加载（服务器停止、I/O 线程池已丢弃加载任务时）
+// 等待者收到 NULL，不修改内容缓存
+void ResourceHost::cancelLoads(){
+    auto pending = std::move(inflight);
+    inflight.clear();
+    for (auto const& [uri, waiters] : pending){
+        for (auto const& waiter : waiters)
+            waiter(nullptr);
+    }
+}
+
+// URI 是否已确认不存在
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+bool ResourceHost::isMissing(std::string const& requestUri){
+    auto it = missing.find(requestUri.substr(0, requestUri.find('?')));
+    if (it == missing.end())
+        return false;
+    missingLru.splice(missingLru.begin(), missingLru, it->second.lru);
+    return true;
+}
 
+// 记录后端确认不存在的 URI
+// 加载期间处理过变更通知时不记录：确认的结果可能已经过时
+// @param requestUri 请求中发送的 URI（查询字符串被忽略）
+// @param wd 后端监视其祖先目录的 wd
+// @param seq 发起加载时的 getNotifySeq()
+void ResourceHost::addMissing(std::string const& requestUri, int32_t wd, uint64_t seq){
+    if (seq != notifySeq)
+        return;
+    std::string uri = requestUri.substr(0, requestUri.find('?'));
+    if (missing.contains(uri))
+        return;
+    // 达到上限时淘汰最久未命中的条目
+    if (missingLru.size() >= MISSING_CACHE_MAX){
+        missing.erase(missingLru.back());
+        missingLru.pop_back();
     }
-    return nullptr;
-}
\ No newline at end of file
+    missingLru.push_front(uri);
+    missing.try_emplace(uri, MissingEntry{wd, missingLru.begin()});
+}
+
+// 处理后端的变更通知，删除挂在发生变化的目录下的负缓存条目
+void ResourceHost::processNotifications(){
+    auto changed = storage->processNotifications();
+    ++notifySeq;
+    if (changed.empty() || missing.empty())
+        return;
+    std::ranges::sort(changed);
+    std::erase_if(missing, [this, &changed](auto const& e){
+        if (!std::ranges::binary_search(changed, e.second.wd))
+            return false;
+        missingLru.erase(e.second.lru);
+        return true;
+    });
+}
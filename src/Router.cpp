@@ -0,0 +1,151 @@
+#include "Router.h"
+
+#include <iostream>
+
+// 注册路由
+// @param methods 方法掩码（methodBit(GET) | methodBit(HEAD) 等）
+// @param pattern 路径模式，见类说明
+// @param handler 处理函数
+// @return 与已有路由冲突（同一路径的方法重叠，或同一位置的参数名不同）时返回 false
+bool Router::add(uint32_t methods, std::string_view pattern, RouteHandler handler){
+    if (methods == 0 || pattern.empty() || handler == nullptr)
+        return false;
+    if (!insert(root, pattern, methods, handler)){
+        std::cout << "Route " << pattern << " conflicts with an existing route" << std::endl;
+        return false;
+    }
+    ++routeCount;
+    return true;
+}
+
+// 在节点下插入路由，按需拆分静态边
+bool Router::insert(Node& node, std::string_view path, uint32_t methods, RouteHandler const& handler){
+    if (path.empty()){
+        if (findRoute(node, methods) != nullptr)
+            return false;
+        node.routes.push_back(Route{methods, handler});
+        return true;
+    }
+
+    // 命名参数：到下一个 '/' 为止
+    if (path[0] == ':'){
+        size_t end = path.find('/');
+        std::string_view name = path.substr(1, end == std::string_view::npos ? std::string_view::npos : end - 1);
+        if (node.param == nullptr){
+            node.param = std::make_unique<Node>();
+            node.paramName = name;
+        } else if (node.paramName != name){
+            return false;
+        }
+        return insert(*node.param, end == std::string_view::npos ? std::string_view() : path.substr(end), methods, handler);
+    }
+
+    // 通配后缀：必须是模式的最后一个片段
+    if (path[0] == '*'){
+        std::string_view name = path.substr(1);
+        if (name.find('/') != std::string_view::npos)
+            return false;
+        if (node.wildcard == nullptr){
+            node.wildcard = std::make_unique<Node>();
+            node.wildcardName = name;
+        } else if (node.wildcardName != name){
+            return false;
+        }
+        return insert(*node.wildcard, std::string_view(), methods, handler);
+    }
+
+    // 静态文本：到下一个以 ':' 或 '*' 开头的片段为止
+    size_t end = 0;
+    while (end < path.length()){
+        if (path[end] == '/' && end + 1 < path.length() && (path[end + 1] == ':' || path[end + 1] == '*')){
+            ++end;
+            break;
+        }
+        ++end;
+    }
+    std::string_view text = path.substr(0, end);
+
+    for (auto& child : node.children){
+        if (child->label[0] != text[0])
+            continue;
+        size_t common = 0;
+        while (common < child->label.length() && common < text.length() && child->label[common] == text[common])
+            ++common;
+        // 只共享部分前缀：拆分已有的边
+        if (common < child->label.length()){
+            auto split = std::make_unique<Node>();
+            split->label = child->label.substr(0, common);
+            child->label.erase(0, common);
+            split->children.push_back(std::move(child));
+            child = std::move(split);
+        }
+        return insert(*child, path.substr(common), methods, handler);
+    }
+
+    auto child = std::make_unique<Node>();
+    child->label = text;
+    node.children.push_back(std::move(child));
+    return insert(*node.children.back(), path.substr(text.length()), methods, handler);
+}
+
+// 在节点的路由中查找支持指定方法的处理函数
+RouteHandler const* Router::findRoute(Node const& node, uint32_t methods){
+    for (auto const& r : node.routes){
+        if (r.methods & methods)
+            return &r.handler;
+    }
+    return nullptr;
+}
+
+// 递归匹配：静态子节点优先，其次参数，最后通配；失败时回溯并撤销捕获的参数
+RouteHandler const* Router::match(Node const& node, std::string_view path, uint32_t method, RouteParams& params) const {
+    uint32_t bit = methodBit(method);
+    if (path.empty()){
+        if (auto h = findRoute(node, bit); h != nullptr)
+            return h;
+    } else {
+        for (auto const& child : node.children){
+            if (child->label[0] != path[0])
+                continue;
+            if (path.starts_with(child->label)){
+                if (auto h = match(*child, path.substr(child->label.length()), method, params); h != nullptr)
+                    return h;
+            }
+            break;
+        }
+    }
+
+    uint32_t saved = params.count;
+    if (node.param != nullptr && !path.empty() && path[0] != '/' && saved < ROUTE_MAX_PARAMS){
+        size_t end = path.find('/');
+        std::string_view seg = path.substr(0, end);
+        params.names[saved] = node.paramName;
+        params.values[saved] = seg;
+        params.count = saved + 1;
+        if (auto h = match(*node.param, path.substr(seg.length()), method, params); h != nullptr)
+            return h;
+        params.count = saved;
+    }
+
+    if (node.wildcard != nullptr && saved < ROUTE_MAX_PARAMS){
+        if (auto h = findRoute(*node.wildcard, bit); h != nullptr){
+            params.names[saved] = node.wildcardName;
+            params.values[saved] = path;
+            params.count = saved + 1;
+            return h;
+        }
+    }
+    return nullptr;
+}
+
+// 查找路由
+// @param method 请求方法
+// @param path 不含查询字符串的请求 URI
+// @param params 匹配成功时填入捕获的参数
+// @return 处理函数，没有匹配的路由时返回 NULL
+RouteHandler const* Router::lookup(uint32_t method, std::string_view path, RouteParams& params) const {
+    params.count = 0;
+    if (method >= 32 || (methodBit(method) & ROUTE_ANY_METHOD) == 0)
+        return nullptr;
+    return match(root, path, method, params);
+}
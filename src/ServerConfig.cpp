@@ -0,0 +1,73 @@
+#include "ServerConfig.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// 读取并解析配置文件
+// @param path 配置文件路径
+// @return 文件无法打开、缺少必需的键或格式错误时返回 false
+bool ServerConfig::load(std::string const& path){
+    std::ifstream cfile(path);
+    if (!cfile.is_open()){
+        std::cout << "Unable to open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (getline(cfile, line)){
+        // 跳过空行 或以a#开头
+        if (line.length() == 0 || line.rfind("#", 0) == 0)
+            continue;
+        size_t epos = line.find("=");
+        values.try_emplace(line.substr(0, epos), epos == std::string::npos ? "" : line.substr(epos + 1));
+    }
+
+    // 验证 vhost、端口和磁盘路径是否存在
+    if (!contains("vhost") || !contains("port") || !contains("diskpath")){
+        std::cout << "vhost, port, and diskpath must be supplied in the config, at a minimum" << std::endl;
+        return false;
+    }
+    port = getInt("port");
+    diskpath = get("diskpath");
+    storage = get("storage", "disk");
+    defaultVhost = get("default_vhost");
+
+    // 将 vhost 分解为逗号分隔的列表（如果有多个 vhost 别名）
+    std::string aliases = get("vhost");
+    size_t pos = 0;
+    do {
+        pos = aliases.find(',');
+        vhostAliases.push_back(aliases.substr(0, pos));
+        aliases.erase(0, pos == std::string::npos ? pos : pos + 1);
+    } while (pos != std::string::npos);
+
+    // 带有独立 docroot 的虚拟主机
+    for (auto const& [k, v] : values){
+        if (!k.starts_with("vhost."))
+            continue;
+        size_t colon = v.find(':');
+        if (colon == std::string::npos){
+            std::cout << k << " must be of the form <storage>:<path>" << std::endl;
+            return false;
+        }
+        vhosts.push_back(VhostSpec{k.substr(6), v.substr(0, colon), v.substr(colon + 1)});
+    }
+    return true;
+}
+
+// 获取字符串值
+// @param key 键
+// @param def 键不存在时的默认值
+std::string ServerConfig::get(std::string_view key, std::string const& def) const {
+    auto it = values.find(key);
+    return it == values.end() ? def : it->second;
+}
+
+// 获取整数值
+// @param key 键
+// @param def 键不存在时的默认值
+int64_t ServerConfig::getInt(std::string_view key, int64_t def) const {
+    auto it = values.find(key);
+    return it == values.end() ? def : strtoll(it->second.c_str(), nullptr, 10);
+}
@@ -0,0 +1,57 @@
+#include "SocketProfile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// 从配置中读取套接字选项
+// tcp_nodelay、tcp_defer_accept、tcp_fastopen、so_sndbuf、so_rcvbuf、tcp_notsent_lowat、so_busy_poll、listen_backlog
+// @param cfg 配置
+SocketProfile SocketProfile::fromConfig(ServerConfig const& cfg){
+    SocketProfile p;
+    p.noDelay = cfg.getInt("tcp_nodelay", 1) != 0;
+    p.deferAccept = cfg.getInt("tcp_defer_accept", 0);
+    p.fastOpen = cfg.getInt("tcp_fastopen", 0);
+    p.sndBuf = cfg.getInt("so_sndbuf", 0);
+    p.rcvBuf = cfg.getInt("so_rcvbuf", 0);
+    p.notSentLowat = cfg.getInt("tcp_notsent_lowat", 0);
+    p.busyPoll = cfg.getInt("so_busy_poll", 0);
+    if (int64_t backlog = cfg.getInt("listen_backlog", 0); backlog > 0)
+        p.backlog = backlog;
+    return p;
+}
+
+// 设置一个选项，失败时只输出警告（例如没有 CAP_NET_ADMIN 时 SO_BUSY_POLL 超过系统上限）
+static void setOption(int32_t fd, int32_t level, int32_t name, int32_t value, char const* label){
+    if (setsockopt(fd, level, name, &value, sizeof(value)) != 0)
+        std::cout << "Could not set " << label << "=" << value << ": " << strerror(errno) << std::endl;
+}
+
+// 在监听套接字上设置选项，须在 listen() 之前调用（缓冲区大小影响 TCP 窗口的协商）
+// @param fd 监听套接字
+void SocketProfile::applyListener(int32_t fd) const {
+    if (noDelay)
+        setOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "tcp_nodelay");
+    if (sndBuf > 0)
+        setOption(fd, SOL_SOCKET, SO_SNDBUF, sndBuf, "so_sndbuf");
+    if (rcvBuf > 0)
+        setOption(fd, SOL_SOCKET, SO_RCVBUF, rcvBuf, "so_rcvbuf");
+#ifdef TCP_DEFER_ACCEPT
+    if (deferAccept > 0)
+        setOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, deferAccept, "tcp_defer_accept");
+#endif
+#ifdef TCP_FASTOPEN
+    if (fastOpen > 0)
+        setOption(fd, IPPROTO_TCP, TCP_FASTOPEN, fastOpen, "tcp_fastopen");
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+    if (notSentLowat > 0)
+        setOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, notSentLowat, "tcp_notsent_lowat");
+#endif
+#ifdef SO_BUSY_POLL
+    if (busyPoll > 0)
+        setOption(fd, SOL_SOCKET, SO_BUSY_POLL, busyPoll, "so_busy_poll");
+#endif
+}
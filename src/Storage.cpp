@@ -0,0 +1,20 @@
+#include "Storage.h"
+
+#include <string>
+#include <unordered_map>
+
+// 将文件扩展名与其MIME类型相关联的字典
+const static std::unordered_map<std::string, std::string, std::hash<std::string>, std::equal_to<>> g_mimeMap = {
+#include "MimeTypes.inc"
+};
+
+// 在字典中查找 MIME 类型
+// @param ext 用于查找的文件扩展名
+// @return MIME 类型，作为字符串。如果未找到类型，则返回空字符串
+std::string Storage::lookupMimeType(std::string const& ext){
+    auto it = g_mimeMap.find(ext);
+    if (it == g_mimeMap.end())
+        return "";
+    
+    return it->second;
+}
@@ -0,0 +1,81 @@
+#include "Task.h"
+
+#include <new>
+#include <string>
+
+namespace {
+
+struct FreeFrame{
+    FreeFrame* next;
+};
+
+// 每个档位的空闲链表和统计，线程局部
+struct FrameClass{
+    FreeFrame* head = nullptr;
+    uint32_t count = 0;
+};
+thread_local FrameClass g_frameClasses[FRAME_POOL_CLASSES];
+thread_local uint64_t g_framePoolHits = 0;
+thread_local uint64_t g_framePoolMisses = 0;
+
+// 计算帧大小对应的档位
+// @return 档位下标，超过最大档位时返回 FRAME_POOL_CLASSES
+uint32_t frameClass(size_t n){
+    uint32_t c = 0;
+    size_t cap = FRAME_POOL_MIN;
+    while (c < FRAME_POOL_CLASSES && n > cap){
+        cap <<= 1;
+        ++c;
+    }
+    return c;
+}
+
+}
+
+// 分配协程帧：优先取对应档位的空闲帧，否则按档位大小向全局堆申请
+// @param n 编译器要求的帧大小
+void* FramePool::allocate(size_t n){
+    uint32_t c = frameClass(n);
+    if (c == FRAME_POOL_CLASSES)
+        return ::operator new(n);
+
+    FrameClass& fc = g_frameClasses[c];
+    if (fc.head != nullptr){
+        FreeFrame* f = fc.head;
+        fc.head = f->next;
+        --fc.count;
+        ++g_framePoolHits;
+        return f;
+    }
+    ++g_framePoolMisses;
+    return ::operator new(FRAME_POOL_MIN << c);
+}
+
+// 释放协程帧：放回对应档位的空闲链表，链表已满时归还给全局堆
+// @param p 帧指针
+// @param n 帧大小（与分配时相同）
+void FramePool::release(void* p, size_t n){
+    uint32_t c = frameClass(n);
+    if (c == FRAME_POOL_CLASSES){
+        ::operator delete(p);
+        return;
+    }
+
+    FrameClass& fc = g_frameClasses[c];
+    if (fc.count >= FRAME_POOL_KEEP){
+        ::operator delete(p);
+        return;
+    }
+    auto f = static_cast<FreeFrame*>(p);
+    f->next = fc.head;
+    fc.head = f;
+    ++fc.count;
+}
+
+// 导出当前线程的帧池命中情况（Prometheus 文本格式）
+std::string FramePool::getMetrics(){
+    std::string ret;
+    ret += "coroutine_frame_pool_hits_total " + std::to_string(g_framePoolHits) + "\n";
+    ret += "coroutine_frame_pool_misses_total " + std::to_string(g_framePoolMisses) + "\n";
+    return ret;
+}
@@ -0,0 +1,78 @@
+#include "TcpFeedback.h"
+
+#include <algorithm>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+
+// 采样连接的 TCP_INFO，更新未发送数据的目标
+// 目标变化超过四分之一时才重新设置 TCP_NOTSENT_LOWAT。
+// sndBufMax 不为 0 且发送缓冲区容不下在途数据加上目标时，把 SO_SNDBUF 增大到两者之和
+// （不超过 sndBufMax，按 setsockopt 的设置值计）。手动设置后内核不再自动调整该连接的缓冲区，因此默认不启用
+// @param fd 套接字
+// @param st 连接的发送状态
+// @param nowUs 当前时间（单调时钟，微秒）
+// @param sndBufMax SO_SNDBUF 的上限，0 表示不调整
+// @param grown 输出是否增大了 SO_SNDBUF
+// @return 平台不支持或获取失败时返回 false
+bool TcpFeedback::sample(int32_t fd, TcpSendState& st, int64_t nowUs, int32_t sndBufMax, bool& grown){
+    grown = false;
+#if defined(__linux__) && defined(TCP_INFO) && defined(TCP_NOTSENT_LOWAT)
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0)
+        return false;
+    st.cwndBytes = info.tcpi_snd_cwnd * info.tcpi_snd_mss;
+    st.rttUs = info.tcpi_rtt;
+    st.nextSampleUs = nowUs + std::clamp<int64_t>(info.tcpi_rtt, TCP_SAMPLE_MIN_US, TCP_SAMPLE_MAX_US);
+
+    uint32_t target = std::clamp<uint64_t>((uint64_t)st.cwndBytes * TCP_BDP_FACTOR, TCP_MIN_UNSENT, TCP_MAX_UNSENT);
+    if (st.target == 0 || target > st.target + st.target / 4 || target < st.target - st.target / 4){
+        int32_t lowat = target;
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) == 0)
+            st.target = target;
+    }
+
+    if (sndBufMax > 0 && !st.sndBufCapped){
+        if (st.sndBuf == 0){
+            len = sizeof(st.sndBuf);
+            getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &st.sndBuf, &len);
+        }
+        // 内核报告的 SO_SNDBUF 是设置值的两倍（包含簿记开销）
+        int64_t size = std::min<int64_t>((int64_t)st.cwndBytes + st.target, sndBufMax);
+        if (size * 2 > st.sndBuf){
+            int32_t value = size;
+            int32_t before = st.sndBuf;
+            len = sizeof(st.sndBuf);
+            if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value)) == 0)
+                getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &st.sndBuf, &len);
+            // 受 net.core.wmem_max 限制没有增大时不再尝试
+            grown = st.sndBuf > before;
+            st.sndBufCapped = !grown || size == sndBufMax;
+        }
+    }
+    return st.target != 0;
+#else
+    (void)fd; (void)st; (void)nowUs; (void)sndBufMax;
+    return false;
+#endif
+}
+
+// 内核发送队列中尚未发送的字节数（不含已发送未确认的）
+// @param fd 套接字
+// @return 平台不支持或获取失败时返回 -1
+int64_t TcpFeedback::unsent(int32_t fd){
+#if defined(__linux__) && defined(SIOCOUTQNSD)
+    int32_t n = 0;
+    if (ioctl(fd, SIOCOUTQNSD, &n) != 0)
+        return -1;
+    return n;
+#else
+    (void)fd;
+    return -1;
+#endif
+}
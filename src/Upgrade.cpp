@@ -0,0 +1,202 @@
+#include "Upgrade.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+extern char** environ;
+
+// 通过 Unix 套接字发送一个描述符
+// 也用于 prefork 工作进程之间迁移空闲连接，此时随描述符附带连接的状态
+// @param sock Unix 套接字
+// @param fd 要发送的描述符
+// @param data 附带的数据，为 NULL 时只发送一个字节
+// @param len 附带数据的长度
+// @return 发送失败时返回 false（非阻塞套接字的缓冲区已满时也是）
+bool Upgrade::sendFd(int32_t sock, int32_t fd, void const* data, size_t len){
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    if (data != nullptr && len > 0)
+        iov = {const_cast<void*>(data), len};
+    alignas(struct cmsghdr) char ctrl[CMSG_SPACE(sizeof(int32_t))];
+    memset(ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int32_t));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int32_t));
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    return n == (ssize_t)iov.iov_len;
+}
+
+// 从 Unix 套接字接收一个描述符（套接字为非阻塞时没有消息立即返回 -1）
+// @param sock Unix 套接字
+// @param data 接收附带数据的缓冲区，为 NULL 时只接收一个字节
+// @param len 附带数据的长度，收到的长度不符时视为失败
+// @return 收到的描述符，失败时返回 -1
+int32_t Upgrade::recvFd(int32_t sock, void* data, size_t len){
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    if (data != nullptr && len > 0)
+        iov = {data, len};
+    alignas(struct cmsghdr) char ctrl[CMSG_SPACE(sizeof(int32_t))];
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    struct cmsghdr* cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        return -1;
+    int32_t fd = -1;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int32_t));
+    if (n != (ssize_t)iov.iov_len){
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+// 按 PATH 查找可执行文件，与 execvp 的规则相同
+// @param name 命令名，含 / 时原样返回
+// @return 可执行文件的路径，找不到时返回空串
+static std::string findExecutable(std::string const& name){
+    if (name.find('/') != std::string::npos)
+        return name;
+    char const* path = getenv("PATH");
+    std::string dirs = path != nullptr ? path : "/usr/local/bin:/bin:/usr/bin";
+    size_t start = 0;
+    while (start <= dirs.size()){
+        size_t end = dirs.find(':', start);
+        if (end == std::string::npos)
+            end = dirs.size();
+        // 空的目录项表示当前目录
+        std::string dir = end > start ? dirs.substr(start, end - start) : ".";
+        std::string file = dir + "/" + name;
+        if (access(file.c_str(), X_OK) == 0)
+            return file;
+        start = end + 1;
+    }
+    return "";
+}
+
+// 启动新的二进制文件并把监听套接字交给它（旧进程）
+// 子进程只保留与旧进程之间的 Unix 套接字（描述符 3），其余描述符全部关闭，
+// 以免客户端连接被新进程继承、旧进程关闭后对端收不到 EOF
+// @param args 新进程的命令行，args[0] 为可执行文件
+// @param listenFd 监听套接字
+// @param channel 输出与新进程之间的 Unix 套接字，用于接收确认
+// @return 新进程的 pid，失败时返回 -1
+pid_t Upgrade::spawn(std::vector<std::string> const& args, int32_t listenFd, int32_t& channel){
+    if (args.empty())
+        return -1;
+    int32_t sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0){
+        std::cout << "socketpair failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    // exec 的路径、参数和环境变量在 fork 之前准备好，子进程中只调用异步信号安全的函数
+    // （setenv 和 execvp 的 PATH 查找都可能分配内存）
+    std::string file = findExecutable(args[0]);
+    if (file.empty()){
+        std::cout << "Could not find executable " << args[0] << std::endl;
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    std::vector<char*> argv;
+    for (auto const& a : args)
+        argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+
+    std::string channelVar = std::string(UPGRADE_ENV) + "=" + std::to_string(UPGRADE_CHANNEL_FD);
+    size_t nameLen = strlen(UPGRADE_ENV);
+    std::vector<char*> envp;
+    for (char** e = environ; *e != nullptr; ++e){
+        if (strncmp(*e, UPGRADE_ENV, nameLen) != 0 || (*e)[nameLen] != '=')
+            envp.push_back(*e);
+    }
+    envp.push_back(channelVar.data());
+    envp.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0){
+        std::cout << "fork failed: " << strerror(errno) << std::endl;
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    if (pid == 0){
+        close(sv[0]);
+        if (sv[1] != UPGRADE_CHANNEL_FD){
+            dup2(sv[1], UPGRADE_CHANNEL_FD);
+            close(sv[1]);
+        }
+#if defined(__linux__)
+        close_range(UPGRADE_CHANNEL_FD + 1, ~0U, 0);
+#elif defined(__FreeBSD__)
+        closefrom(UPGRADE_CHANNEL_FD + 1);
+#else
+        for (int32_t fd = UPGRADE_CHANNEL_FD + 1, max = sysconf(_SC_OPEN_MAX); fd < max; ++fd)
+            close(fd);
+#endif
+        // 信号屏蔽字会被 exec 继承
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        execve(file.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+
+    close(sv[1]);
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+    if (!sendFd(sv[0], listenFd)){
+        std::cout << "Could not pass the listening socket to pid " << pid << std::endl;
+        close(sv[0]);
+        kill(pid, SIGTERM);
+        return -1;
+    }
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    channel = sv[0];
+    return pid;
+}
+
+// 取得旧进程留下的 Unix 套接字（新进程）
+// 环境变量随即清除，避免再次升级时被误用
+// @return Unix 套接字，不是以升级方式启动时返回 -1
+int32_t Upgrade::takeInheritedChannel(){
+    char const* val = getenv(UPGRADE_ENV);
+    if (val == nullptr)
+        return -1;
+    int32_t fd = atoi(val);
+    unsetenv(UPGRADE_ENV);
+    if (fd < 0 || fcntl(fd, F_GETFD) == -1)
+        return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
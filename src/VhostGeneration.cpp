@@ -0,0 +1,78 @@
+#include "VhostGeneration.h"
+
+#include <iostream>
+
+// 获取 (storage, path) 对应的资源主机
+// 本代已创建的直接返回；上一代中存在相同后端的沿用（缓存得以保留），否则新建
+// @param storage 存储后端
+// @param path 后端的路径
+// @param previous 上一代，首次构建时为 NULL
+std::shared_ptr<ResourceHost> VhostGeneration::getHost(std::string const& storage, std::string const& path, VhostGeneration const* previous){
+    std::string spec = storage + ":" + path;
+    if (auto it = bySpec.find(spec); it != bySpec.end())
+        return it->second;
+
+    std::shared_ptr<ResourceHost> resHost;
+    if (previous != nullptr){
+        if (auto it = previous->bySpec.find(spec); it != previous->bySpec.end()){
+            resHost = it->second;
+            ++reused;
+        }
+    }
+    if (resHost == nullptr)
+        resHost = std::make_shared<ResourceHost>(path, storage);
+    bySpec.try_emplace(spec, resHost);
+    hostList.push_back(resHost);
+    return resHost;
+}
+
+// 添加 diskpath 的资源主机，它始终为 localhost/127.0.0.1 和 vhost 别名提供服务，也是默认主机
+// @param diskpath vhost 服务文件夹的路径
+// @param storage diskpath 的存储后端
+// @param aliases vhost 别名
+// @param previous 上一代
+void VhostGeneration::addPrimary(std::string const& diskpath, std::string const& storage,
+                                 std::vector<std::string> const& aliases, VhostGeneration const* previous){
+    auto resHost = getHost(storage, diskpath, previous);
+    hostTable.add("localhost", resHost);
+    hostTable.add("127.0.0.1", resHost);
+    for (auto const& vh : aliases){
+        if (hostTable.find(vh) != nullptr)
+            continue;
+        if (hostTable.add(vh, resHost))
+            std::cout << "vhost: " << vh << std::endl;
+    }
+}
+
+// 添加带独立 docroot 的虚拟主机
+// @param host 主机名（不含端口）
+// @param storage 存储后端
+// @param path 后端的路径
+// @param previous 上一代
+// @return 主机名无效时返回 false
+bool VhostGeneration::addVhost(std::string const& host, std::string const& storage, std::string const& path, VhostGeneration const* previous){
+    if (HostTable::bareHost(host).empty() || HostTable::bareHost(host).length() > HOST_NAME_MAX_LEN){
+        std::cout << "vhost " << host << " is empty or too long, skipping" << std::endl;
+        return false;
+    }
+    std::cout << "vhost: " << host << " (" << storage << ": " << path << ")" << std::endl;
+    return hostTable.add(host, getHost(storage, path, previous));
+}
+
+// 根据配置构建新的一代（可能阻塞：内存后端会读取整个 docroot，可在 I/O 线程上调用）
+// 路由表不在这里构建，由事件循环在替换前安装
+// @param cfg 配置
+// @param previous 当前的一代，其中后端相同的资源主机被沿用
+// @return 新的一代，默认主机无效时返回 NULL
+std::shared_ptr<VhostGeneration> VhostGeneration::build(ServerConfig const& cfg, VhostGeneration const* previous){
+    auto gen = std::make_shared<VhostGeneration>();
+    gen->id = previous != nullptr ? previous->id + 1 : 0;
+    gen->addPrimary(cfg.diskpath, cfg.storage, cfg.vhostAliases, previous);
+    for (auto const& spec : cfg.vhosts)
+        gen->addVhost(spec.host, spec.storage, spec.path, previous);
+    if (!cfg.defaultVhost.empty() && !gen->hostTable.setDefault(cfg.defaultVhost)){
+        std::cout << "default_vhost " << cfg.defaultVhost << " is not a configured vhost" << std::endl;
+        return nullptr;
+    }
+    return gen;
+}
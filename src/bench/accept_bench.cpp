@@ -0,0 +1,111 @@
+// 接受连接方式的对比测试：每个就绪事件 accept() + fcntl() 一次，与 accept4() 循环取空接受队列
+// 客户端线程不断地建立连接再关闭；服务器线程用 poll() 等待监听套接字就绪后接受连接并立即关闭。
+// 比较每秒接受的连接数和每个连接的 poll() 次数
+//
+// 编译：g++ -std=c++2b -O2 -pthread accept_bench.cpp -o accept_bench
+// 运行：./accept_bench [客户端线程数] [秒数] [积压队列长度]
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+constexpr uint32_t BATCH = 64;
+
+struct Result{
+    uint64_t accepted = 0;
+    uint64_t polls = 0;
+};
+
+// 创建监听套接字，端口由系统分配
+static int32_t makeListener(int32_t backlog, sockaddr_in& addr){
+    int32_t fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int32_t on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    listen(fd, backlog);
+    return fd;
+}
+
+// 客户端：连接后立即关闭
+static void client(sockaddr_in addr, std::atomic<bool>& stop){
+    while (!stop.load(std::memory_order_relaxed)){
+        int32_t fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        // 立即回收端口，避免 TIME_WAIT 耗尽本地端口
+        linger lg{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        connect(fd, (sockaddr*)&addr, sizeof(addr));
+        close(fd);
+    }
+}
+
+static Result run(bool drain, uint32_t clients, uint32_t seconds, int32_t backlog){
+    sockaddr_in addr;
+    int32_t lfd = makeListener(backlog, addr);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < clients; ++i)
+        threads.emplace_back(client, addr, std::ref(stop));
+
+    Result r;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end){
+        pollfd p{lfd, POLLIN, 0};
+        if (poll(&p, 1, 100) <= 0)
+            continue;
+        ++r.polls;
+        if (!drain){
+            // 旧方式：每次就绪接受一个连接，再用 fcntl 设置非阻塞
+            int32_t fd = accept(lfd, nullptr, nullptr);
+            if (fd == -1)
+                continue;
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            ++r.accepted;
+            close(fd);
+            continue;
+        }
+        for (uint32_t i = 0; i < BATCH; ++i){
+            int32_t fd = accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1)
+                break;
+            ++r.accepted;
+            close(fd);
+        }
+    }
+    stop = true;
+    close(lfd);
+    for (auto& t : threads)
+        t.join();
+    return r;
+}
+
+int main(int argc, char** argv){
+    uint32_t clients = argc > 1 ? atoi(argv[1]) : 8;
+    uint32_t seconds = argc > 2 ? atoi(argv[2]) : 3;
+    int32_t backlog = argc > 3 ? atoi(argv[3]) : SOMAXCONN;
+
+    for (bool drain : {false, true}){
+        Result r = run(drain, clients, seconds, backlog);
+        std::cout << (drain ? "accept4 loop:   " : "accept + fcntl: ")
+                  << r.accepted / seconds << " conn/s, "
+                  << (r.accepted > 0 ? (double)r.polls / r.accepted : 0) << " polls/conn" << std::endl;
+    }
+    return 0;
+}
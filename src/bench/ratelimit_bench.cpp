@@ -0,0 +1,47 @@
+// 按 IP 限速的检查开销
+// 用给定数量的随机 IP 反复调用 RateLimiter::allow()，报告每次检查的平均耗时和被拒绝的比例；
+// IP 数超过表的容量时同时测量淘汰路径
+//
+// 编译：g++ -std=c++2b -O2 -I../head ratelimit_bench.cpp ../RateLimiter.cpp -o ratelimit_bench
+// 运行：./ratelimit_bench [IP 数] [检查次数] [表容量]
+
+#include "RateLimiter.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv){
+    uint32_t ips = argc > 1 ? atoi(argv[1]) : 10000;
+    uint64_t checks = argc > 2 ? strtoull(argv[2], nullptr, 10) : 20000000;
+    uint32_t capacity = argc > 3 ? atoi(argv[3]) : RATE_LIMIT_TABLE_SIZE;
+
+    RateLimiter limiter;
+    if (!limiter.init(capacity))
+        return 1;
+    limiter.setRate(100, 200);
+
+    std::mt19937 rng(42);
+    std::vector<uint32_t> addrs(ips);
+    for (auto& a : addrs)
+        a = rng() | 1;
+    std::vector<uint32_t> order(1 << 20);
+    for (auto& i : order)
+        i = rng() % ips;
+
+    uint64_t allowed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; n < checks; ++n){
+        // 模拟时间流逝：每 1000 次检查前进 1 毫秒
+        allowed += limiter.allow(addrs[order[n & (order.size() - 1)]], n / 1000);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "ips=" << ips << " checks=" << checks << " capacity=" << capacity << std::endl;
+    std::cout << "ns/check=" << (double)ns / checks << " allowed=" << (double)allowed / checks * 100 << "%" << std::endl;
+    std::cout << limiter.getMetrics();
+    return 0;
+}
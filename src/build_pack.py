@@ -0,0 +1,166 @@
+import os
+import re
+import sys
+import gzip
+import struct
+import hashlib
+import argparse
+
+# Must match PackFile.h
+PACK_MAGIC = b"HSPACK01"
+PACK_VERSION = 1
+HEADER_FMT = "<8sIIIIQQQ16s"
+ENTRY_FMT = "<QQQIIIIIHBB16s"
+ALIGN = 4096
+VALID_INDEXES = ["index.html", "index.htm"]
+COMPRESSIBLE_PREFIXES = ("text/", "application/javascript", "application/json", "application/xml", "image/svg+xml")
+
+
+def fnv1a64(data):
+    h = 0xcbf29ce484222325
+    for c in data:
+        h ^= c
+        h = (h * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def align(n):
+    return (n + ALIGN - 1) & ~(ALIGN - 1)
+
+
+def load_mimetypes(path):
+    mapping = {}
+    if path is None:
+        return mapping
+    with open(path, "r") as fh:
+        for line in fh:
+            m = re.match(r'\s*\{"([^"]+)",\s*"([^"]+)"\}', line)
+            if m:
+                mapping[m.group(1)] = m.group(2)
+    return mapping
+
+
+def collect(docroot):
+    # (uri, disk path) for every servable file, plus directory aliases for index files
+    files = []
+    for dirpath, dirnames, filenames in os.walk(docroot):
+        # Hidden files and directories are never served
+        dirnames[:] = sorted(d for d in dirnames if not d.startswith("."))
+        rel = os.path.relpath(dirpath, docroot)
+        uri_dir = "/" if rel == "." else "/" + rel.replace(os.sep, "/") + "/"
+        for name in sorted(filenames):
+            if name.startswith("."):
+                continue
+            files.append((uri_dir + name, os.path.join(dirpath, name)))
+        for index in VALID_INDEXES:
+            if index in filenames:
+                files.append((uri_dir, os.path.join(dirpath, index)))
+                if uri_dir != "/":
+                    files.append((uri_dir[:-1], os.path.join(dirpath, index)))
+                break
+    return files
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Bundle a docroot into a memory-mappable pack file for ResourceHost")
+    parser.add_argument('-d', '--docroot', required=True, type=str, help='Path to the docroot to pack')
+    parser.add_argument('-o', '--output', required=True, type=str, help='Path to target .pack file to overwrite')
+    parser.add_argument('-m', '--mimetypes', type=str, help='Path to MimeTypes.inc used by the server')
+    parser.add_argument('--no-gzip', action='store_true', help='Do not store precompressed gzip variants')
+
+    args = parser.parse_args()
+    if not os.path.isdir(args.docroot):
+        print("Docroot must be an existing directory")
+        parser.print_help()
+        return 1
+
+    mimes = load_mimetypes(args.mimetypes)
+    files = collect(args.docroot)
+
+    # Bodies are stored once per disk file even when several URIs point to it
+    bodies = {}
+    for uri, path in files:
+        if path in bodies:
+            continue
+        with open(path, "rb") as fh:
+            data = fh.read()
+        ext = path.rsplit(".", 1)[1] if "." in os.path.basename(path) else ""
+        mime = mimes.get(ext, "application/octet-stream")
+        etag = '"' + hashlib.sha1(data).hexdigest()[:16] + '"'
+        gz = b""
+        if not args.no_gzip and len(data) > 256 and mime.startswith(COMPRESSIBLE_PREFIXES):
+            gz = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(gz) >= len(data) * 0.9:
+                gz = b""
+        bodies[path] = {"data": data, "gzip": gz, "mime": mime, "etag": etag}
+
+    # Open addressing table with load factor <= 0.5
+    bucket_count = 1
+    while bucket_count < max(2 * len(files), 1):
+        bucket_count *= 2
+
+    header_size = struct.calcsize(HEADER_FMT)
+    entry_size = struct.calcsize(ENTRY_FMT)
+    index_offset = header_size
+    strings_offset = index_offset + bucket_count * entry_size
+
+    strings = bytearray()
+    string_pos = {}
+
+    def add_string(s):
+        b = s.encode("utf-8")
+        if b not in string_pos:
+            string_pos[b] = strings_offset + len(strings)
+            strings.extend(b)
+        return string_pos[b], len(b)
+
+    for uri, path in files:
+        add_string(uri)
+        add_string(bodies[path]["mime"])
+        add_string(bodies[path]["etag"])
+
+    # Lay out 4K aligned bodies after the strings region
+    pos = align(strings_offset + len(strings))
+    for path, body in bodies.items():
+        body["offset"] = pos
+        pos = align(pos + len(body["data"]))
+        if body["gzip"]:
+            body["gzip_offset"] = pos
+            pos = align(pos + len(body["gzip"]))
+        else:
+            body["gzip_offset"] = 0
+
+    buckets = [None] * bucket_count
+    for uri, path in files:
+        h = fnv1a64(uri.encode("utf-8"))
+        i = h & (bucket_count - 1)
+        while buckets[i] is not None:
+            i = (i + 1) & (bucket_count - 1)
+        body = bodies[path]
+        uri_off, uri_len = add_string(uri)
+        mime_off, mime_len = add_string(body["mime"])
+        etag_off, etag_len = add_string(body["etag"])
+        buckets[i] = struct.pack(ENTRY_FMT, h, body["offset"], body["gzip_offset"],
+                                 len(body["data"]), len(body["gzip"]),
+                                 uri_off, mime_off, etag_off, uri_len, mime_len, etag_len, b"")
+
+    with open(args.output, "wb") as fh:
+        fh.write(struct.pack(HEADER_FMT, PACK_MAGIC, PACK_VERSION, len(files), bucket_count, 0,
+                             index_offset, strings_offset, len(strings), b""))
+        empty = b"\0" * entry_size
+        for b in buckets:
+            fh.write(b if b is not None else empty)
+        fh.write(strings)
+        for path, body in bodies.items():
+            fh.seek(body["offset"])
+            fh.write(body["data"])
+            if body["gzip"]:
+                fh.seek(body["gzip_offset"])
+                fh.write(body["gzip"])
+        fh.truncate(pos)
+
+    print(f"Packed {len(files)} URIs ({len(bodies)} files) into {args.output}")
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#ifndef _ADMISSIONCONTROL_H_
+#define _ADMISSIONCONTROL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+constexpr uint32_t ADMISSION_TARGET_MS = 5;       // 可以接受的排队延迟
+constexpr uint32_t ADMISSION_INTERVAL_MS = 100;   // 延迟持续超过目标这么久才开始拒绝
+constexpr uint32_t ADMISSION_RETRY_AFTER = 1;     // 503 响应的 Retry-After（秒）
+
+// 拒绝的原因，用作计数器的下标
+enum ShedReason {
+    SHED_OVERLOAD = 0,        // 排队延迟持续超过目标
+    SHED_MAX_CONNECTIONS,     // 超过全局连接数上限
+    SHED_VHOST_CONNECTIONS,   // 超过虚拟主机的连接数上限
+    SHED_REASON_COUNT
+};
+
+// 延迟信号，各自独立判断是否持续高于目标
+enum DelaySignal {
+    DELAY_LOOP_LAG = 0,   // 事件循环一轮的处理时间（其间到达的事件要等待的时间），空闲的一轮为零
+    DELAY_SOJOURN,        // 请求从其读事件被取出到开始处理的时间，不含请求自己的服务时间
+    DELAY_SIGNAL_COUNT
+};
+
+// 准入控制（CoDel）
+// 每个延迟信号在一个完整的间隔内都高于目标时进入拒绝状态：按 interval / sqrt(count) 的间隔拒绝新的连接和请求，
+// 延迟持续越久拒绝越频繁；该信号出现一次低于目标的延迟即退出。
+// 两个信号分开判断，一个信号的低样本不会解除另一个信号的拒绝状态；任一信号处于拒绝状态即拒绝。只在事件循环线程上使用
+class AdmissionController{
+    using Clock = std::chrono::steady_clock;
+
+    struct SignalState{
+        Clock::time_point firstAbove{};   // 延迟开始高于目标后，这个时间点之后进入拒绝状态；为零表示低于目标
+        bool dropping = false;
+        Clock::duration lastDelay{};
+    };
+
+    Clock::duration target = std::chrono::milliseconds(ADMISSION_TARGET_MS);
+    Clock::duration interval = std::chrono::milliseconds(ADMISSION_INTERVAL_MS);
+    SignalState signals[DELAY_SIGNAL_COUNT];
+    Clock::time_point dropNext{};
+    uint32_t count = 0;               // 本次拒绝状态中已拒绝的次数
+
+    uint64_t shed[SHED_REASON_COUNT] = {0};
+
+public:
+    void setTarget(uint32_t ms) {
+        target = std::chrono::milliseconds(ms);
+    }
+
+    void observe(DelaySignal signal, Clock::duration delay, Clock::time_point now);
+    bool shouldShed(Clock::time_point now);
+
+    void recordShed(ShedReason reason) {
+        ++shed[reason];
+    }
+
+    bool isDropping() const {
+        for (auto const& s : signals){
+            if (s.dropping)
+                return true;
+        }
+        return false;
+    }
+
+    std::string getMetrics() const;
+};
+
+#endif
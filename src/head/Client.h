@@ -2,17 +2,42 @@
 #define _CLIENT_H_
 
 #include "SendQueueItem.h"
+#include "TcpFeedback.h"
 
 // #include <netinet/in.h>
 // #include <arpa/inet.h>
 #include <winsock2.h>
 #include <windows.h>
+#include <algorithm>
+#include <ctime>
+#include <functional>
+#include <memory>
 #include <queue>
 
+class ResourceHost;
+
+// 发送队列的字节水位：超过高水位暂停读取该连接的新请求，回落到低水位以下再恢复，
+// 不读取响应的客户端最多让服务器缓存高水位加一个响应的数据
+constexpr uint64_t SEND_QUEUE_HIGH_WATER = 256 * 1024;
+constexpr uint64_t SEND_QUEUE_LOW_WATER = 64 * 1024;
+
 class Client{
     int32_t socketDesc;
     sockaddr_in clientAddr;
     std::queue<SendQueueItem*> sendQueue;
+    uint64_t queuedBytes = 0;   // 发送队列中尚未发送的字节数
+    bool readPaused = false;    // 读取事件已被禁用（挂起或超过高水位）
+    bool parked = false;  // 正在等待 I/O 线程池加载资源，期间不读取新的请求
+    // 等待套接字可读（或发送队列清空）的协程回调，参数为 false 表示连接已断开
+    std::function<void(bool)> ioWaiter;
+    bool waitingRead = false;
+    time_t lastActive = time(nullptr);   // 最近一次收到请求的时间
+    std::shared_ptr<ResourceHost> vhost;   // 计入其连接数的资源主机
+    // 写调度的状态
+    uint32_t writeDeficit = 0;     // 差额轮询中上一轮没有用完的份额
+    int32_t writeAvail = 0;        // 发送缓冲区的可用空间（最近一次写事件报告的值减去之后发送的量）
+    bool writeScheduled = false;   // 已在写调度队列中
+    TcpSendState tcpState;         // TCP_INFO 的采样结果
 
 public:
     Client(int fd, sockaddr_in addr);
@@ -33,6 +58,101 @@ public:
         return inet_ntoa(clientAddr.sin_addr);
     }
 
+    void setParked(bool p){
+        parked = p;
+    }
+
+    bool isParked() const {
+        return parked;
+    }
+
+    void setIoWaiter(std::function<void(bool)> waiter, bool read){
+        ioWaiter = std::move(waiter);
+        waitingRead = read;
+    }
+
+    bool hasIoWaiter() const {
+        return ioWaiter != nullptr;
+    }
+
+    bool isWaitingRead() const {
+        return ioWaiter != nullptr && waitingRead;
+    }
+
+    // 取出等待回调，之后不再有协程在等待该客户端
+    std::function<void(bool)> takeIoWaiter(){
+        auto waiter = std::move(ioWaiter);
+        ioWaiter = nullptr;
+        waitingRead = false;
+        return waiter;
+    }
+
+    void touch(time_t now){
+        lastActive = now;
+    }
+
+    time_t getLastActive() const {
+        return lastActive;
+    }
+
+    void setVhost(std::shared_ptr<ResourceHost> host){
+        vhost = std::move(host);
+    }
+
+    std::shared_ptr<ResourceHost> const& getVhost() const {
+        return vhost;
+    }
+
+    // 空闲：没有待发送的响应、没有正在加载的资源、没有协程在等待
+    // 空闲的保持连接没有任何请求状态，可以直接关闭或交给其他进程
+    bool isIdle() const {
+        return sendQueue.empty() && !parked && ioWaiter == nullptr;
+    }
+
+    uint64_t getQueuedBytes() const {
+        return queuedBytes;
+    }
+
+    void markSent(uint32_t n){
+        queuedBytes -= std::min<uint64_t>(n, queuedBytes);
+    }
+
+    void setReadPaused(bool p){
+        readPaused = p;
+    }
+
+    bool isReadPaused() const {
+        return readPaused;
+    }
+
+    void setWriteDeficit(uint32_t d){
+        writeDeficit = d;
+    }
+
+    uint32_t getWriteDeficit() const {
+        return writeDeficit;
+    }
+
+    void setWriteAvail(int32_t avail){
+        writeAvail = avail;
+    }
+
+    int32_t getWriteAvail() const {
+        return writeAvail;
+    }
+
+    void setWriteScheduled(bool s){
+        writeScheduled = s;
+    }
+
+    bool isWriteScheduled() const {
+        return writeScheduled;
+    }
+
+    TcpSendState& getTcpState(){
+        return tcpState;
+    }
+
     void addToSendQueue(SendQueueItem* item);
     uint32_t sendQueueSize() const;
     SendQueueItem* nextInSendQueue();
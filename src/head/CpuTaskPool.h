@@ -0,0 +1,77 @@
+#ifndef _CPUTASKPOOL_H_
+#define _CPUTASKPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t CPU_POOL_THREADS = 2;            // 默认 CPU 线程数
+constexpr uint32_t CPU_POOL_QUEUE_MAX = 4096;       // 所有工作线程队列中等待执行的任务上限
+constexpr uint32_t CPU_OFFLOAD_BYTES = 256 * 1024;  // 正文不小于该值的响应在 CPU 线程池上构造
+
+// 交给 CPU 线程池的一项任务
+struct CpuTask{
+    std::function<void()> work;  // 在工作线程上执行（不应阻塞）
+    std::function<void()> done;  // work 完成后回到事件循环线程执行
+};
+
+// CPU 密集任务的工作窃取线程池
+// 每个工作线程有自己的双端队列：事件循环轮流把任务放到各队列尾部，工作线程从自己队列的尾部取任务，
+// 自己的队列为空时从其他队列的头部窃取
+// 完成的任务放入无锁的多生产者单消费者链表，只有链表由空变为非空时才写管道唤醒事件循环，
+// 由事件循环线程调用 runCompletions() 执行 done 回调
+// 任务对象（包括 work 捕获的变量）总是在事件循环线程上析构
+class CpuTaskPool{
+private:
+    struct WorkerQueue{
+        std::deque<CpuTask> tasks;
+        std::mutex mutex;            // 只在提交和窃取时与其他线程竞争
+        std::atomic<uint32_t> depth{0};   // tasks.size() 的副本，供统计时无锁读取
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};  // 本线程从其他队列窃取的任务数
+    };
+    struct Completion{
+        CpuTask task;
+        Completion* next = nullptr;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<Completion*> completed{nullptr};  // 已完成任务的链表（后完成的在前）
+    std::atomic<uint32_t> queued{0};              // 所有队列中等待执行的任务数
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    uint32_t nextQueue = 0;           // 下一次提交使用的队列，只在事件循环线程上访问
+    uint32_t maxPending;
+    int32_t wakePipe[2] = {-1, -1};   // [0] 由事件循环监视，[1] 由工作线程写入
+
+    bool takeTask(uint32_t self, CpuTask& task);
+    void workerLoop(uint32_t self);
+    void postCompletion(CpuTask task);
+
+public:
+    explicit CpuTaskPool(uint32_t numThreads = CPU_POOL_THREADS, uint32_t pendingLimit = CPU_POOL_QUEUE_MAX);
+    ~CpuTaskPool();
+    CpuTaskPool(CpuTaskPool const&) = delete;
+    CpuTaskPool& operator=(CpuTaskPool const&) = delete;
+
+    bool submit(CpuTask task);
+    void runCompletions();
+
+    // 事件循环需要监视的唤醒描述符
+    int32_t getWakeFd() const {
+        return wakePipe[0];
+    }
+
+    std::string getMetrics() const;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _DIRLISTING_H_
+#define _DIRLISTING_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+constexpr uint32_t DIR_PAGE_SIZE = 1000;     // 每页显示的目录条目数
+constexpr uint32_t DIR_BATCH_BYTES = 32768;  // 每次 getdents64 读取的缓冲区大小
+
+// 目录列表
+// 缓存一个目录的（已排序）条目名，目录的 mtime 变化时需要重新加载
+// 条目按批读取，输出按页渲染，因此超大目录不会一次生成完整的页面
+class DirListing{
+private:
+    std::vector<std::string> names;
+    time_t mtime = 0;
+    long mtimeNsec = 0;
+    ino_t ino = 0;
+
+public:
+    DirListing() = default;
+    ~DirListing() = default;
+
+    bool load(int32_t fd, struct stat const& sb);
+    bool isStale(struct stat const& sb) const;
+
+    uint32_t getNumEntries() const {
+        return names.size();
+    }
+
+    uint32_t getNumPages() const {
+        return names.empty() ? 1 : (names.size() + DIR_PAGE_SIZE - 1) / DIR_PAGE_SIZE;
+    }
+
+    std::string renderHtml(std::string const& uri, uint32_t page) const;
+    std::string renderJson(std::string const& uri, uint32_t page) const;
+};
+
+#endif
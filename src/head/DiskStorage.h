@@ -0,0 +1,81 @@
+#ifndef _DISKSTORAGE_H_
+#define _DISKSTORAGE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "DirListing.h"
+#include "FdCache.h"
+#include "Storage.h"
+
+constexpr uint32_t NEG_CACHE_MAX = 4096;  // 负缓存最多记录的不存在 URI 数
+constexpr uint32_t DIR_CACHE_MAX = 128;   // 最多缓存的目录列表数
+
+// 磁盘存储后端
+// 通过 FdCache 相对 docroot 解析路径，附带负缓存（inotify 失效）和目录列表缓存
+class DiskStorage : public Storage{
+private:
+    std::string baseDiskPath;  // 本地文件系统路径
+    // load() 会在 I/O 线程上并发执行，lookupMutex 保护 fdCache 和目录列表缓存
+    // 文件内容的 pread 在锁外进行
+    std::mutex lookupMutex;
+    FdCache fdCache;           // URI -> 已打开的描述符 / stat 结果 / 查找错误
+
+    // notifyMutex 保护负缓存、监视表和待失效的 FdCache 条目，持有期间不做系统调用，
+    // 事件循环处理变更通知时只取这把锁。两把锁都要取时先取 lookupMutex
+    std::mutex notifyMutex;
+    std::vector<std::string> staleUris;   // 待失效的 FdCache 条目，I/O 线程在下一次查找前应用
+    std::vector<std::string> staleDirs;   // 待按前缀失效的目录（以 / 结尾）
+    std::unordered_set<int32_t> unknownWds;   // 登记之前就收到事件的 wd
+    uint64_t notifyGen = 0;               // 每读到一批变更通知加一
+
+    // 负缓存：已确认不存在的 URI -> 监视其最近的存在祖先目录的 inotify wd
+    // 被监视目录发生变化时，挂在该 wd 下的条目全部失效
+    int32_t notifyFd = -1;
+    struct NegEntry{
+        int32_t wd;
+        std::list<std::string>::iterator pos;   // 在 negLru 中的位置
+    };
+    std::unordered_map<std::string, NegEntry> negEntries;
+    std::list<std::string> negLru;                       // 最近命中的在前，用于限制负缓存大小
+    std::unordered_map<int32_t, std::string> watchDirs;  // wd -> 目录 URI
+    std::unordered_map<std::string, int32_t> dirWatches; // 目录 URI -> wd
+
+    // 目录列表缓存：目录 URI -> 已加载的条目，目录 mtime 变化时重新加载
+    // 加载和渲染在锁外进行，大目录不会阻塞其他 I/O 线程的查找
+    std::unordered_map<std::string, std::shared_ptr<DirListing const>> dirListings;
+
+    int32_t watchAncestor(std::string const& uri);
+    void addNegative(std::string const& uri);
+    void dropNegatives(int32_t wd);
+    void applyInvalidations();
+
+    std::unique_ptr<Resource> readFile(std::string const& uri, int32_t fd, struct stat const& sb);   //  从 FS 将文件读入资源对象
+
+    std::unique_ptr<Resource> readDirectory(std::string uri, struct stat const& sb, std::string const& query,
+                                            std::unique_lock<std::mutex>& lock);  // 将目录列表或索引从 FS 读入资源对象
+
+    std::shared_ptr<DirListing const> getDirListing(std::string const& uri, int32_t fd, struct stat const& sb,
+                                                    std::unique_lock<std::mutex>& lock);  // 获取（必要时重新加载）目录列表
+
+public:
+    explicit DiskStorage(std::string const& base);
+    ~DiskStorage() override;
+
+    std::unique_ptr<Resource> load(std::string const& uri) override;
+    bool isFresh(Resource const& res) override;
+    void prefetch(std::string const& uri) override;
+
+    int32_t getNotifyFd() const override {
+        return notifyFd;
+    }
+    std::vector<int32_t> processNotifications() override;
+    int32_t getMissingWatch(std::string const& requestUri) override;
+};
+
+#endif
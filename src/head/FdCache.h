@@ -0,0 +1,56 @@
+#ifndef _FDCACHE_H_
+#define _FDCACHE_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+
+constexpr time_t FD_CACHE_TTL = 5;         // 缓存条目有效期（秒）
+constexpr uint32_t FD_CACHE_MAX = 1024;    // 最多缓存的条目数（即最多持有的文件描述符数）
+
+// 一条缓存记录：打开的描述符 + stat 结果，或者查找失败时的 errno
+struct FdCacheEntry{
+    int32_t fd = -1;
+    int32_t err = 0;           // 0 表示查找成功，否则为 openat/fstat 的 errno
+    struct stat sb = {};
+    time_t expires = 0;
+};
+
+// 以 URI 为键的已打开文件描述符缓存
+// 所有路径都通过 openat() 相对于缓存的 docroot 目录描述符解析，
+// Linux 下使用 openat2(RESOLVE_BENEATH) 保证解析结果不会逃出 docroot
+class FdCache{
+private:
+    int32_t rootFd = -1;             // docroot 目录描述符
+    bool beneathSupported = false;   // 内核是否支持 openat2(RESOLVE_BENEATH)
+    time_t ttl;
+    uint32_t maxEntries;
+    std::unordered_map<std::string, FdCacheEntry> entries;
+
+    int32_t openBeneath(std::string const& relPath);
+    void evict();
+
+public:
+    explicit FdCache(std::string const& root, time_t entryTtl = FD_CACHE_TTL, uint32_t entryLimit = FD_CACHE_MAX);
+    ~FdCache();
+    FdCache(FdCache const&) = delete;
+    FdCache& operator=(FdCache const&) = delete;
+
+    FdCacheEntry const* lookup(std::string const& uri, bool* hit = nullptr);
+    void invalidate(std::string const& uri);
+    void invalidatePrefix(std::string const& prefix);
+    void clear();
+
+    int32_t getRootFd() const {
+        return rootFd;
+    }
+
+    // 不支持 RESOLVE_BENEATH 时，调用者仍需自行拒绝 "../"
+    bool isConfined() const {
+        return beneathSupported;
+    }
+};
+
+#endif
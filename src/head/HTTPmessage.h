@@ -4,9 +4,9 @@
 #include<map>
 #include<memory>
 #include<string>
+#include<string_view>
 
 #include"ByteBuffer.h"
-// #include <string_view>
 
 const std::string HTTP_VERSION_10 = "HTTP/1.0";
 const std::string HTTP_VERSION_11 = "HTTP/1.1";
@@ -48,9 +48,11 @@ enum Status {
     
     BAD_REQUEST = 400,
     NOT_FOUND = 404,
+    TOO_MANY_REQUESTS = 429,
 
     SERVER_ERROR = 500,
-    NOT_IMPLENTED = 501
+    NOT_IMPLENTED = 501,
+    SERVICE_UNAVAILABLE = 503
 };
 
 class HTTPMessage : public ByteBuffer{
@@ -88,6 +90,7 @@ public:
     void addHeader(std::string const& key, std::string const& value);
     void addHeader(std::string const& key, int32_t value);
     std::string getHeaderValue(std::string const& key) const;
+    std::string_view getHeaderView(std::string_view key) const;
     std::string getHeaderStr(int32_t index) const;
     uint32_t getNumHeaders() const;
     void clearHeaders();
@@ -1,12 +1,29 @@
 #ifndef _HTTPSERVER_H_
 #define _HTTPSERVER_H_
 
+#include "AdmissionControl.h"
 #include "Client.h"
+#include "CpuTaskPool.h"
 #include "HTTPrequest.h"
 #include "HTTPresponse.h"
+#include "IOThreadPool.h"
+#include "Master.h"
+#include "MemoryController.h"
+#include "RateLimiter.h"
 #include "Resourcehost.h"
+#include "Router.h"
+#include "ServerConfig.h"
+#include "SocketProfile.h"
+#include "Task.h"
+#include "Upgrade.h"
+#include "VhostGeneration.h"
 
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <queue>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -20,12 +37,25 @@
 // constexpr int32_t INVALID_SOCKET = -1;   INVALID_SOCKET 在windows中 winsock2.h已定义
 constexpr uint32_t QUEUE_SIZE = 1024;
 
+// 写调度（差额轮询）：每轮事件循环给每个可写的连接 WRITE_QUANTUM 字节的份额，大响应不能独占事件循环；
+// 剩余待发送量不超过 WRITE_PRIORITY_BYTES 的小响应优先发送。每轮最多发送 WRITE_ITERATION_BUDGET 字节
+constexpr uint32_t WRITE_QUANTUM = 16 * 1024;
+constexpr uint32_t WRITE_PRIORITY_BYTES = 16 * 1024;
+constexpr uint64_t WRITE_ITERATION_BUDGET = 1024 * 1024;
+constexpr int32_t WRITE_TRICKLE_BYTES = 64;
+
+// 信号自管道中的命令字节
+constexpr char SIGNAL_RELOAD = 'R';    // SIGHUP：重新加载配置
+constexpr char SIGNAL_UPGRADE = 'U';   // SIGUSR2：不停机升级
+
 class HTTPServer 
 {
     //Server Socket
     int32_t listenPort;
     int32_t listenSocket = INVALID_SOCKET;
+    bool sharedListener = false;   // 监听套接字由 prefork master 创建，与其他工作进程共享
     struct sockaddr_in serverAddr;
+    SocketProfile socketProfile;   // 监听套接字的选项
     int32_t dropUid;
     int32_t dropGid;
 
@@ -36,13 +66,133 @@ class HTTPServer
     // struct kevent evList[QUEUE_SIZE];  //  已触发 kqueue 中过滤器的事件（每次最大 QUEUE_SIZE）
     fd_set readfds[QUEUE_SIZE];  // windows 下用文件描述符搭配select
 
+    // 磁盘 I/O 线程池：内容缓存未命中的文件和目录列表在这里加载
+    uint32_t ioThreads;
+    std::unique_ptr<IOThreadPool> ioPool;
+    std::deque<IOTask> deferredIO;   // 线程池队列已满时暂存的任务，有任务完成后按顺序重新提交
+    void submitIO(IOTask task);
+    void flushDeferredIO();
+
+    // CPU 线程池：大响应的构造等 CPU 密集阶段在这里执行，不占用事件循环
+    uint32_t cpuThreads;
+    std::unique_ptr<CpuTaskPool> cpuPool;
+
+    // 根据内存压力调整各资源主机内容缓存的容量
+    std::unique_ptr<MemoryController> memController;
+    void applyCacheBudget();
+    time_t lastCompact = 0;   // 上一次整理缓存 arena 的时间
+
     // client map,将套接字描述符映射到客户端对象
     std::unordered_map<int, std::shared_ptr<Client>> clientMap;
+    uint64_t readPauses = 0;   // 发送队列超过高水位而暂停读取的次数
+
+    // 写调度：写事件只登记客户端，本轮事件处理完后由 runWrites() 统一发送，没有轮到的留到下一轮
+    std::deque<std::shared_ptr<Client>> writeSmall;   // 小响应，优先发送
+    std::deque<std::shared_ptr<Client>> writeBulk;    // 其余的连接，差额轮询
+    uint32_t writePriorityBytes = WRITE_PRIORITY_BYTES;   // 0 表示不区分小响应
+    uint64_t writeSmallBytes = 0;
+    uint64_t writeBulkBytes = 0;
+    uint64_t writeBudgetExhausted = 0;   // 发送预算用完、有连接顺延到下一轮的次数
+    bool adaptiveSend = true;   // 按 TCP_INFO 和内核中未发送的数据量确定发送量
+    int32_t sndBufMax = 0;      // 自动增大 SO_SNDBUF 的上限，0 表示不调整
+    uint64_t tcpSamples = 0;
+    uint64_t sndBufGrown = 0;
+    int32_t sendAllowance(std::shared_ptr<Client> const& cl, int64_t nowUs);
+    void scheduleWrite(std::shared_ptr<Client> cl, int32_t avail);
+    void runWrites();
+    uint32_t serviceWrite(std::shared_ptr<Client> const& cl, uint32_t maxBytes, bool& more);
+    void finishWrite(std::shared_ptr<Client> const& cl, bool more);
+
+    //资源/文件系统：当前一代的资源主机、虚拟主机表和各主机的路由表
+    // 只在事件循环线程上读取和替换；需要跨越事件使用的地方持有资源主机的 shared_ptr
+    std::shared_ptr<VhostGeneration> gen;
+
+    // 路由：各虚拟主机（按主机名区分）自己的路由表优先，其次是所有主机共用的路由表
+    // 共用路由表中预先注册了 GET/HEAD/OPTIONS/TRACE 的默认处理函数；内置的健康检查和指标端点按配置安装到指定的主机
+    Router globalRouter;
+    struct HostRoute{
+        std::string host;
+        uint32_t methods;
+        std::string pattern;
+        RouteHandler handler;
+    };
+    std::vector<HostRoute> hostRoutes;   // 按主机名注册的路由，重新加载后安装到新的一代
+    void registerBuiltinRoutes();
+    bool installHostRoute(VhostGeneration& g, HostRoute const& route);
+
+    // 信号自管道：信号处理函数只写一个命令字节，由事件循环处理
+    int32_t signalPipe[2] = {-1, -1};
+    void processSignals();
+
+    // SIGHUP 重新加载配置：在 I/O 线程上构建新的一代
+    std::string configPath = "";
+    bool reloading = false;       // 正在构建新的一代
+    bool reloadAgain = false;     // 构建期间又收到了 SIGHUP
+    void reload();
+    void swapGeneration(std::shared_ptr<VhostGeneration> next, ServerConfig const& cfg);
+
+    // SIGUSR2 不停机升级：把监听套接字交给新的二进制文件，然后停止接受连接、等待已有连接结束
+    std::vector<std::string> execArgs;   // 新进程的命令行
+    int32_t upgradeChannel = -1;   // 与新进程之间的 Unix 套接字，等待其确认
+    pid_t upgradePid = -1;
+    bool draining = false;
+    time_t drainDeadline = 0;
+    void upgrade();
+    void finishUpgrade();
+    void closeIdleClients();
+    bool bindListenSocket();
 
-    //资源/文件系统
-    std::vector<std::shared_ptr<ResourceHost>> hostList;  // 包含所有资源主机
-    std::unordered_map<std::string, std::shared_ptr<ResourceHost>, std::hash<std::string>, std::equal_to<>> vhost;   // 虚拟主机。将主机字符串映射到资源主机，以便为请求提供服务
-    //  使用string的默认哈希函数， 和默认相等比较函数
+    // prefork 工作进程的计数器（共享内存），不是工作进程时为 NULL
+    WorkerStats* workerStats = nullptr;
+    StatsSegment* statsSegment = nullptr;
+    uint32_t workerSlot = 0;
+
+    // 工作进程之间的负载均衡：负载过高时暂停接受连接，并把空闲的保持连接迁移给负载最低的工作进程
+    bool acceptPaused = false;
+    void rebalance(time_t now);
+    bool migrateClient(std::shared_ptr<Client> cl, WorkerStats& target);
+    void adoptClients();
+    void addClient(int32_t clfd, sockaddr_in addr);
+
+    // 协程处理函数
+    using AsyncHandler = std::function<Task(HTTPServer&, std::shared_ptr<Client>, std::shared_ptr<HTTPRequest>)>;
+
+    // 协程调度：到期的定时器和已就绪的协程在每轮事件处理之后恢复
+    struct Timer{
+        std::chrono::steady_clock::time_point deadline;
+        std::coroutine_handle<> handle;
+        bool operator>(Timer const& other) const {
+            return deadline > other.deadline;
+        }
+    };
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    std::deque<std::coroutine_handle<>> readyCoroutines;
+    void schedule(std::coroutine_handle<> h) {
+        readyCoroutines.push_back(h);
+    }
+    void runTimers();
+    void resumeReady();
+    struct timespec nextTimeout() const;
+    Task runAsyncHandler(AsyncHandler handler, std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
+
+    // 准入控制：排队延迟持续过高或超过连接数上限时，用预渲染的 503 快速拒绝，不再排队
+    AdmissionController admission;
+    std::chrono::steady_clock::time_point loopStart{};   // 本轮开始处理事件的时间，请求的排队时间从这里算起
+    uint32_t maxConnections = 0;    // 全局连接数上限，0 表示不限
+    std::string overloadResponse;   // 预渲染的完整 503 响应（带 Retry-After 和 Connection: close）
+    void renderOverloadResponse();
+    void shedRequest(std::shared_ptr<Client> cl, ShedReason reason);
+
+    // 按客户端 IP 限速，超过速率的请求在解析之前用预渲染的 429 拒绝
+    RateLimiter* rateLimiter = nullptr;   // 由 main 创建（prefork 时所有工作进程共享），未启用时为 NULL
+    std::string rateLimitResponse;        // 预渲染的完整 429 响应（带 Retry-After 和 Connection: close）
+    void sendPrerendered(std::shared_ptr<Client> cl, std::string const& raw);
+
+    // 预渲染的完整 404 响应（Connection: close），事件循环侧负缓存命中时直接发送
+    std::string notFoundResponse;
+
+    // 预渲染的状态响应正文（status -> 正文），避免重复的错误响应每次重新构造
+    std::unordered_map<int32_t, std::string> statusBodies;
 
     //  连接处理
     void updateEvent(int ident, short filter, u_short flags, u_int fflags, int32_t data, void* udata);
@@ -50,24 +200,142 @@ class HTTPServer
     std::shared_ptr<Client> getClient(int clfd);
     void disconnectClient(std::shared_ptr<Client> cl, bool mapErase=true);
     void readClient(std::shared_ptr<Client> cl, int32_t data_len);
-    bool writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes);
+    bool writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes, int32_t* sent = nullptr);
     std::shared_ptr<ResourceHost> getResourceHostForRequest(const HTTPRequest* const req);
+    std::string_view getHostNameForRequest(const HTTPRequest* const req) const;
+    std::shared_ptr<ResourceHost> getHostForNotifyFd(int fd) const;
 
     // 请求处理
-    void handleRequest(std::shared_ptr<Client> cl, HTTPRequest* const req);
+    void handleRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
     void handleGet(std::shared_ptr<Client> cl, const HTTPRequest* const req);
     void handleOptions(std::shared_ptr<Client> cl, const HTTPRequest* const req);
     void handleTrace(std::shared_ptr<Client> cl, HTTPRequest* const req);
+    void handleHealth(std::shared_ptr<Client> cl, const HTTPRequest* const req);
+    void handleMetrics(std::shared_ptr<Client> cl, const HTTPRequest* const req);
+    bool shouldDisconnect(const HTTPRequest* const req) const;
+    void loadResourceAsync(std::shared_ptr<Client> cl, std::shared_ptr<ResourceHost> resHost, std::string const& uri, uint32_t method, bool dc);
+    void startLoad(std::shared_ptr<ResourceHost> resHost, std::string const& uri, std::function<void(std::shared_ptr<Resource>)> waiter);
+    std::shared_ptr<Resource> lookupCached(std::shared_ptr<ResourceHost> const& resHost, std::string const& uri);
 
     // 响应
     void sendStatusResponse(std::shared_ptr<Client> cl, int32_t status, std::string const& msg = "");
     void sendResponse(std::shared_ptr<Client> cl, std::unique_ptr<HTTPResponse> resp, bool disconnect);
+    void offloadResponse(std::shared_ptr<Client> cl, std::function<std::unique_ptr<HTTPResponse>()> build, bool disconnect);
+    static SendQueueItem* finishResponse(HTTPResponse& resp, bool disconnect);
+    void sendResource(std::shared_ptr<Client> cl, std::shared_ptr<Resource> r, uint32_t method, bool dc);
 
     bool canRun=false;
 
-    HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port, std::string const& diskpath, int32_t drop_uid=0, int32_t drop_gid=0);
+    HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port, std::string const& diskpath, int32_t drop_uid=0, int32_t drop_gid=0,
+               uint32_t io_threads=IO_POOL_THREADS, std::string const& storage="disk", uint32_t cpu_threads=CPU_POOL_THREADS);
     ~HTTPServer();
 
+    // 协程处理函数可以等待的操作，都在事件循环线程上恢复
+    // 加载资源（内容缓存未命中时在 I/O 线程池上加载），结果为 NULL 表示资源不存在
+    struct LoadAwaiter{
+        HTTPServer* server;
+        std::shared_ptr<ResourceHost> host;
+        std::string uri;
+        std::shared_ptr<Resource> result = nullptr;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        std::shared_ptr<Resource> await_resume() {
+            return std::move(result);
+        }
+    };
+    // 等待一段时间
+    struct SleepAwaiter{
+        HTTPServer* server;
+        std::chrono::milliseconds delay;
+        bool await_ready() const {
+            return delay.count() <= 0;
+        }
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const {}
+    };
+    // 发送响应并等待发送队列清空，结果为 false 表示连接已断开
+    struct SendAwaiter{
+        HTTPServer* server;
+        std::shared_ptr<Client> cl;
+        std::unique_ptr<HTTPResponse> resp;
+        bool disconnect;
+        bool ok = false;
+        bool await_ready() const {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h);
+        bool await_resume() const {
+            return ok;
+        }
+    };
+    // 等待客户端发来数据，结果为空表示连接已关闭
+    struct RecvAwaiter{
+        HTTPServer* server;
+        std::shared_ptr<Client> cl;
+        uint32_t maxLen;
+        std::string data = "";
+        bool await_ready() const {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h);
+        std::string await_resume() {
+            return std::move(data);
+        }
+    };
+
+    LoadAwaiter load(std::shared_ptr<ResourceHost> host, std::string const& uri) {
+        return LoadAwaiter{this, std::move(host), uri};
+    }
+    SleepAwaiter sleepFor(std::chrono::milliseconds delay) {
+        return SleepAwaiter{this, delay};
+    }
+    SendAwaiter respond(std::shared_ptr<Client> cl, std::unique_ptr<HTTPResponse> resp, bool disconnect) {
+        return SendAwaiter{this, std::move(cl), std::move(resp), disconnect};
+    }
+    RecvAwaiter receive(std::shared_ptr<Client> cl, uint32_t maxLen = 4096) {
+        return RecvAwaiter{this, std::move(cl), maxLen};
+    }
+
+    bool addRoute(std::string const& host, uint32_t methods, std::string const& pattern, RouteHandler handler);
+    bool addAsyncHandler(std::string const& host, uint32_t methods, std::string const& pattern, AsyncHandler handler);
+    void addVhost(std::string const& host, std::string const& storage, std::string const& path);
+    bool setDefaultVhost(std::string const& host);
+    void setConfigPath(std::string const& path) {
+        configPath = path;
+    }
+    void setExecArgs(std::vector<std::string> const& args) {
+        execArgs = args;
+    }
+    void setListenSocket(int32_t fd) {
+        listenSocket = fd;
+        sharedListener = true;
+    }
+    void setSocketProfile(SocketProfile const& profile) {
+        socketProfile = profile;
+    }
+    void setRateLimiter(RateLimiter* limiter) {
+        rateLimiter = limiter;
+    }
+    void setWorkerStats(StatsSegment* stats, uint32_t slot) {
+        statsSegment = stats;
+        workerStats = stats != nullptr ? &stats->slots[slot] : nullptr;
+        workerSlot = slot;
+    }
+    void notifyReload();
+    void notifyUpgrade();
+    void setCacheLimits(uint64_t minBytes, uint64_t maxBytes);
+    void setWritePriority(uint32_t bytes) {
+        writePriorityBytes = bytes;
+    }
+    void setSendSizing(bool adaptive, int32_t sndBufLimit) {
+        adaptiveSend = adaptive;
+        sndBufMax = sndBufLimit;
+    }
+    void applyAdmissionConfig(ServerConfig const& cfg);
+    void applyEndpointConfig(ServerConfig const& cfg);
+    std::string getMetrics() const;
+    void warmUp(std::vector<std::pair<std::string, std::string>> const& entries);
+
     bool start();
     void stop();
 
@@ -0,0 +1,63 @@
+#ifndef _HOSTTABLE_H_
+#define _HOSTTABLE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class ResourceHost;
+
+constexpr size_t HOST_NAME_MAX_LEN = 253;   // DNS 主机名的最大长度
+
+// 虚拟主机表
+// 启动时构建：键为小写的裸主机名（不含端口），查找时直接使用请求中 Host 头的 string_view，
+// 去掉端口和末尾的 '.' 后按不区分大小写的方式比较，每次请求不分配内存
+class HostTable{
+public:
+    // 不区分大小写的哈希与比较，支持以 string_view 异构查找（按主机名索引的其他表也使用）
+    struct CaseInsensitiveHash{
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const;
+    };
+    struct CaseInsensitiveEqual{
+        using is_transparent = void;
+        bool operator()(std::string_view a, std::string_view b) const;
+    };
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<ResourceHost>, CaseInsensitiveHash, CaseInsensitiveEqual> hosts;
+    std::shared_ptr<ResourceHost> defaultHost;   // 未匹配时使用的主机
+    std::string defaultName;                     // 默认主机的名字（小写）
+    bool explicitDefault = false;                // 默认主机是否由配置指定
+
+public:
+    HostTable() = default;
+    ~HostTable() = default;
+
+    static std::string_view bareHost(std::string_view host);
+
+    bool add(std::string_view host, std::shared_ptr<ResourceHost> resHost);
+    std::shared_ptr<ResourceHost> find(std::string_view host) const;
+    bool setDefault(std::string_view host);
+    void clear();
+
+    std::shared_ptr<ResourceHost> getDefault() const {
+        return defaultHost;
+    }
+
+    std::string const& getDefaultName() const {
+        return defaultName;
+    }
+
+    bool hasExplicitDefault() const {
+        return explicitDefault;
+    }
+
+    size_t size() const {
+        return hosts.size();
+    }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _IOTHREADPOOL_H_
+#define _IOTHREADPOOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t IO_POOL_THREADS = 4;       // 默认 I/O 线程数
+constexpr uint32_t IO_POOL_QUEUE_MAX = 1024;  // 等待执行的任务上限
+
+// 交给 I/O 线程池的一项任务
+struct IOTask{
+    std::function<void()> work;  // 在 I/O 线程上执行（可以阻塞）
+    std::function<void()> done;  // work 完成后回到事件循环线程执行
+};
+
+// 磁盘 I/O 线程池
+// 阻塞的文件读取和目录生成在工作线程上执行，完成回调放入完成队列，
+// 再通过管道唤醒事件循环，由事件循环线程调用 runCompletions() 执行
+class IOThreadPool{
+private:
+    std::vector<std::thread> workers;
+    std::deque<IOTask> pending;        // 等待执行的任务
+    std::deque<IOTask> completed;      // 已执行完 work、等待执行 done 的任务
+    std::mutex pendingMutex;
+    std::mutex completedMutex;
+    std::condition_variable pendingCv;
+    uint32_t maxPending;
+    bool stopping = false;
+    int32_t wakePipe[2] = {-1, -1};    // [0] 由事件循环监视，[1] 由工作线程写入
+
+    void workerLoop();
+
+public:
+    explicit IOThreadPool(uint32_t numThreads = IO_POOL_THREADS, uint32_t pendingLimit = IO_POOL_QUEUE_MAX);
+    ~IOThreadPool();
+    IOThreadPool(IOThreadPool const&) = delete;
+    IOThreadPool& operator=(IOThreadPool const&) = delete;
+
+    bool submit(IOTask task);
+    void runCompletions();
+
+    // 事件循环需要监视的唤醒描述符
+    int32_t getWakeFd() const {
+        return wakePipe[0];
+    }
+};
+
+#endif
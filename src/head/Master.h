@@ -0,0 +1,99 @@
+#ifndef _MASTER_H_
+#define _MASTER_H_
+
+#include "SocketProfile.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <ctime>
+#include <netinet/in.h>
+#include <sys/types.h>
+
+constexpr uint32_t MASTER_MAX_WORKERS = 64;
+constexpr int32_t WORKER_MIN_UPTIME_MS = 1000;    // 启动后这么快就退出的工作进程视为启动失败
+constexpr int32_t WORKER_RESPAWN_DELAY_MS = 100;  // 启动失败时的重启间隔，避免 fork 风暴
+
+// 工作进程之间的负载均衡：连接数超过平均值的 REBALANCE_HIGH_RATIO 倍且至少多出 REBALANCE_MIN_EXCESS 个时，
+// 暂停接受新连接，并把空闲超过 REBALANCE_IDLE_SECONDS 秒的保持连接迁移给连接数最少的工作进程
+constexpr double REBALANCE_HIGH_RATIO = 1.25;
+constexpr int64_t REBALANCE_MIN_EXCESS = 8;
+constexpr uint32_t REBALANCE_BATCH = 32;          // 每秒最多迁移的连接数
+constexpr int32_t REBALANCE_IDLE_SECONDS = 1;
+
+// 单个工作进程的计数器，位于共享内存中，由工作进程更新、任一进程读取
+struct WorkerStats{
+    // 迁移连接的收件箱（SOCK_DGRAM socketpair 的两端），master 在 fork 之前创建，所有进程继承同样的描述符号
+    // 内核的数据报队列就是多生产者单消费者队列，描述符随 SCM_RIGHTS 一起传递
+    int32_t inbox = -1;    // 本槽位的工作进程读取
+    int32_t outbox = -1;   // 其他工作进程写入
+
+    std::atomic<int32_t> pid{0};
+    std::atomic<uint64_t> restarts{0};     // 该槽位的重启次数
+    std::atomic<uint64_t> accepted{0};     // 接受的连接数
+    std::atomic<int64_t> active{0};        // 当前连接数（工作进程重启时清零）
+    std::atomic<uint64_t> requests{0};     // 处理的请求数
+    std::atomic<uint64_t> bytesSent{0};    // 发送的字节数
+    std::atomic<uint64_t> migratedIn{0};   // 从其他工作进程接收的空闲连接数
+    std::atomic<uint64_t> migratedOut{0};  // 迁移给其他工作进程的空闲连接数
+    std::atomic<uint32_t> acceptPaused{0}; // 负载过高，暂停接受新连接
+    std::atomic<uint64_t> busyMicros{0};   // 事件循环处理事件（而非等待）的累计时间
+};
+
+// 迁移连接时随描述符附带的状态
+// 只迁移空闲的保持连接，它们没有未处理的请求数据，请求解析器也没有状态
+struct MigratedClient{
+    struct sockaddr_in addr;
+    time_t lastActive;
+};
+
+// 所有工作进程的计数器，master 在 fork 之前映射为 MAP_SHARED
+struct StatsSegment{
+    uint32_t workers = 0;
+    WorkerStats slots[MASTER_MAX_WORKERS];
+
+    std::string getMetrics() const;
+    int64_t getMeanActive() const;
+    int32_t getLeastLoaded(uint32_t except) const;
+};
+
+// prefork master
+// 绑定监听套接字后 fork 出 N 个工作进程，工作进程共享同一个监听套接字、各自运行完整的 HTTPServer，
+// 彼此不共享内存状态（计数器除外），一个进程崩溃不影响其他进程。
+// master 只负责重启退出的工作进程和转发 SIGTERM/SIGINT/SIGHUP，不处理请求（SIGUSR2 升级不支持，收到后忽略）
+class Master{
+    uint32_t workers;
+    int32_t listenSocket = -1;
+    StatsSegment* stats = nullptr;
+    std::vector<pid_t> pids;   // 槽位 -> pid
+    std::vector<std::chrono::steady_clock::time_point> startedAt;
+    std::function<int32_t(uint32_t)> workerMain;
+    sigset_t origMask;   // run() 之前的信号屏蔽字，工作进程恢复它
+
+    pid_t spawn(uint32_t slot);
+    int32_t findSlot(pid_t pid) const;
+    void signalWorkers(int32_t sig);
+
+public:
+    Master(uint32_t workers);
+    ~Master();
+    Master(Master const&) = delete;
+    Master& operator=(Master const&) = delete;
+
+    bool listen(int32_t port, int32_t dropUid, int32_t dropGid, SocketProfile const& profile);
+    int32_t run(std::function<int32_t(uint32_t)> main);
+    static void releaseWorkerSignals();
+
+    int32_t getListenSocket() const {
+        return listenSocket;
+    }
+    StatsSegment* getStats() const {
+        return stats;
+    }
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef _MEMORYCONTROLLER_H_
+#define _MEMORYCONTROLLER_H_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+constexpr uint64_t MEMCTL_MIN_BUDGET = 8 * 1024 * 1024;      // 缓存预算下限
+constexpr uint64_t MEMCTL_MAX_BUDGET = 1024 * 1024 * 1024;   // 缓存预算上限（cgroup 限制更小时以 cgroup 为准）
+constexpr double MEMCTL_PRESSURE_HIGH = 10.0;   // some avg10 超过该值（%）时收缩
+constexpr double MEMCTL_PRESSURE_LOW = 1.0;     // some avg10 低于该值（%）时才允许增长
+constexpr double MEMCTL_USAGE_HIGH = 0.90;      // cgroup 用量超过 memory.max 的该比例时收缩
+constexpr double MEMCTL_USAGE_LOW = 0.75;       // 增长后的用量不得超过 memory.max 的该比例
+
+// 内存压力控制器
+// 周期性读取 /proc/pressure/memory（PSI）和 cgroup v2 的 memory.max / memory.current，
+// 以 AIMD 方式调整缓存总预算：有压力时按比例收缩，空闲时按固定步长增长
+// 采样在事件循环线程上进行：这些文件在构造时打开一次，之后每次只 pread，不再解析路径
+class MemoryController{
+private:
+    std::string cgroupDir;          // 本进程所在 cgroup v2 目录，不可用时为空
+    int32_t psiFd = -1;             // /proc/pressure/memory，不可用时为 -1
+    int32_t cgroupMaxFd = -1;       // memory.max
+    int32_t cgroupCurrentFd = -1;   // memory.current
+    uint64_t configMin;             // 配置的上下限（未按 cgroup 限制调整），用于判断重新加载时是否变化
+    uint64_t configMax;
+    uint64_t minBudget;
+    uint64_t maxBudget;
+    uint64_t budget;
+
+    // 最近一次采样
+    double someAvg10 = 0.0;
+    double fullAvg10 = 0.0;
+    bool psiAvailable = false;
+    uint64_t cgroupMax = 0;         // 0 表示没有限制或不可读
+    uint64_t cgroupCurrent = 0;
+
+    // 决策计数
+    uint64_t shrinkCount = 0;
+    uint64_t growCount = 0;
+    time_t lastTick = 0;
+
+    void sample();
+
+public:
+    MemoryController(uint64_t minBytes = MEMCTL_MIN_BUDGET, uint64_t maxBytes = MEMCTL_MAX_BUDGET);
+    ~MemoryController();
+    MemoryController(MemoryController const&) = delete;
+    MemoryController& operator=(MemoryController const&) = delete;
+
+    bool tick(time_t now);
+    bool setLimits(uint64_t minBytes, uint64_t maxBytes);
+
+    uint64_t getBudget() const {
+        return budget;
+    }
+
+    std::string getMetrics() const;
+};
+
+#endif
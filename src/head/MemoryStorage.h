@@ -0,0 +1,31 @@
+#ifndef _MEMORYSTORAGE_H_
+#define _MEMORYSTORAGE_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Storage.h"
+
+// 内存存储后端
+// 创建时把整个 docroot（文件、目录索引和目录列表的第一页）读入内存，之后不再访问文件系统
+// 内容是启动时的快照，修改 docroot 后需要重新加载配置
+class MemoryStorage : public Storage{
+private:
+    std::string baseDiskPath;
+    std::unordered_map<std::string, std::shared_ptr<Resource>> resources;  // URI -> 资源
+    uint64_t totalBytes = 0;
+
+public:
+    explicit MemoryStorage(std::string const& base);
+    ~MemoryStorage() override = default;
+
+    std::unique_ptr<Resource> load(std::string const& uri) override;
+
+    bool isNonBlocking() const override {
+        return true;
+    }
+    std::shared_ptr<Resource> lookup(std::string const& uri, bool acceptGzip) override;
+};
+
+#endif
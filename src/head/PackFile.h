@@ -0,0 +1,86 @@
+#ifndef _PACKFILE_H_
+#define _PACKFILE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 静态资源包格式（由 build_pack.py 离线生成，所有整数均为小端序）
+//
+//   PackHeader                      64 字节
+//   PackEntry[bucketCount]          开放寻址哈希表（线性探测），键为 URI 的 FNV-1a 64 位哈希
+//   字符串区                         URI、MIME 类型、ETag
+//   正文区                           每个正文（及其 gzip 版本）都按 4K 对齐
+//
+// 目录的索引文件以 "/dir/" 和 "/dir" 两个键重复登记，指向同一份正文
+
+constexpr char PACK_MAGIC[8] = {'H', 'S', 'P', 'A', 'C', 'K', '0', '1'};
+constexpr uint32_t PACK_VERSION = 1;
+
+struct PackHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t bucketCount;     // 2 的幂
+    uint32_t reserved0;
+    uint64_t indexOffset;     // PackEntry 数组的文件偏移
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint8_t reserved1[16];
+};
+static_assert(sizeof(PackHeader) == 64, "PackHeader must be 64 bytes");
+
+struct PackEntry{
+    uint64_t hash;
+    uint64_t bodyOffset;
+    uint64_t gzipOffset;
+    uint32_t bodyLen;
+    uint32_t gzipLen;         // 0 表示没有预压缩版本
+    uint32_t uriOffset;       // 字符串均为文件偏移
+    uint32_t mimeOffset;
+    uint32_t etagOffset;
+    uint16_t uriLen;          // 0 表示空桶
+    uint8_t mimeLen;
+    uint8_t etagLen;
+    uint32_t reserved[4];
+};
+static_assert(sizeof(PackEntry) == 64, "PackEntry must be 64 bytes");
+
+// 只读映射的资源包
+// 打开时只做一次 mmap（O(1) 启动），查找是一次哈希探测，不产生系统调用
+class PackFile{
+private:
+    const uint8_t* base = nullptr;
+    size_t mapLen = 0;
+    const PackHeader* header = nullptr;
+    const PackEntry* buckets = nullptr;
+
+    bool inBounds(uint64_t off, uint64_t len) const;
+    bool validate() const;
+    bool validEntry(const PackEntry& e) const;
+
+public:
+    PackFile() = default;
+    ~PackFile();
+    PackFile(PackFile const&) = delete;
+    PackFile& operator=(PackFile const&) = delete;
+
+    bool open(std::string const& path);
+    const PackEntry* find(std::string_view uri) const;
+
+    std::string_view getString(uint32_t off, uint32_t len) const {
+        return std::string_view((const char*)base + off, len);
+    }
+
+    const uint8_t* getBytes(uint64_t off) const {
+        return base + off;
+    }
+
+    uint32_t getEntryCount() const {
+        return header == nullptr ? 0 : header->entryCount;
+    }
+
+    static uint64_t hashUri(std::string_view uri);
+};
+
+#endif
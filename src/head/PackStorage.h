@@ -0,0 +1,30 @@
+#ifndef _PACKSTORAGE_H_
+#define _PACKSTORAGE_H_
+
+#include <memory>
+#include <string>
+
+#include "PackFile.h"
+#include "Storage.h"
+
+// 资源包存储后端
+// 资源直接引用 mmap 的资源包内存，查找是一次哈希探测，不产生系统调用
+class PackStorage : public Storage{
+private:
+    std::string packPath;
+    std::shared_ptr<PackFile> pack;   // 资源对象共享映射，资源主机销毁后正在发送的正文仍然有效
+    bool mapped = false;
+
+public:
+    explicit PackStorage(std::string const& path);
+    ~PackStorage() override = default;
+
+    std::unique_ptr<Resource> load(std::string const& uri) override;
+
+    bool isNonBlocking() const override {
+        return true;
+    }
+    std::shared_ptr<Resource> lookup(std::string const& uri, bool acceptGzip) override;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _RATELIMITER_H_
+#define _RATELIMITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+constexpr uint32_t RATE_LIMIT_TABLE_SIZE = 65536;   // 默认最多跟踪的 IP 数
+constexpr uint32_t RATE_LIMIT_WAYS = 8;              // 每组的槽位数，一个 IP 只会放在它所属的组中
+constexpr uint32_t RATE_LIMIT_CLAIM_RETRIES = 4;     // 抢占槽位失败时重新查找的次数，仍失败则放行
+constexpr uint32_t RATE_LIMIT_RETRY_AFTER = 1;       // 429 响应的 Retry-After（秒）
+
+// 一个 IP 的令牌桶
+// 令牌以千分之一为单位保存；不做定时补充，访问时按距上次访问的时间补充（惰性衰减）。
+// 令牌数和上次访问时间放在同一个 64 位字中，用一次 CAS 更新
+struct RateBucket{
+    std::atomic<uint32_t> addr;    // IPv4 地址（网络字节序），0 表示空槽位
+    uint32_t pad;
+    std::atomic<uint64_t> state;   // 高 32 位：剩余令牌数 × 1000；低 32 位：上次访问的时间（单调时钟毫秒数的低 32 位）
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the shared rate limit table needs address-free atomics");
+
+// 按客户端 IP 限制请求速率（令牌桶）
+// 表是组相联的开放寻址表：IP 散列到一组 RATE_LIMIT_WAYS 个槽位，组内线性查找；
+// 组满时淘汰组内最久未访问的 IP（近似 LRU），内存占用固定。
+// 表映射为 MAP_SHARED，在 prefork 之前创建时所有工作进程共享同一份计数。
+// 槽位只用 CAS 更新，不加锁：持有槽位的工作进程崩溃不会阻塞其他进程。
+// 抢占槽位和写入初始令牌是两步，并发时计数可能有少量误差，限速只需要近似准确。
+// 检查不分配内存，只访问一组槽位（两条缓存行）
+class RateLimiter{
+    RateBucket* slots = nullptr;
+    uint32_t groupMask = 0;   // 组数 - 1
+    size_t mapped = 0;
+
+    // 以下各进程自己保存，重新加载配置后各自更新
+    uint32_t ratePerSec = 0;   // 每秒补充的令牌数，0 表示不限制
+    uint32_t burst = 0;        // 桶的容量
+    uint64_t limited = 0;      // 本进程拒绝的请求数
+    uint64_t evicted = 0;      // 本进程淘汰的 IP 数
+
+public:
+    RateLimiter() = default;
+    ~RateLimiter();
+    RateLimiter(RateLimiter const&) = delete;
+    RateLimiter& operator=(RateLimiter const&) = delete;
+
+    bool init(uint32_t capacity);
+    void setRate(uint32_t perSec, uint32_t burstSize);
+    bool allow(uint32_t addr, uint64_t nowMs);
+
+    bool isEnabled() const {
+        return slots != nullptr && ratePerSec > 0;
+    }
+
+    std::string getMetrics() const;
+};
+
+#endif
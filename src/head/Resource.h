@@ -4,13 +4,22 @@
 #include<string>
 #include<memory>
 
+class ResourceArena;
+
 class Resource{
 private:
     uint8_t* data = nullptr;  // file data
+    bool ownsData = true;     // false 表示 data 指向外部内存（如 mmap 的资源包），析构时不释放
     uint32_t size = 0;        // 无符号整数
     std::string mimeType = "";
     std::string location;     // 服务器内的磁盘路径
     bool directory;
+    uint64_t inode = 0;       // 加载时文件的 inode 和修改时间，用于判断缓存内容是否过期
+    int64_t mtime = 0;
+    std::string etag = "";          // 预先计算的 ETag（资源包提供）
+    std::string contentEncoding = "";  // 非空表示 data 是预压缩的版本（如 gzip）
+    std::shared_ptr<ResourceArena> arena;   // 非空表示 data 分配在该 arena 中
+    std::shared_ptr<void const> dataOwner;  // data 指向外部内存时持有其所有者（如资源包的映射），资源对象存活期间内存不会释放
 
 public:
     Resource(std::string const& loc, bool dir=false);
@@ -21,15 +30,44 @@ public:
         data = d;
         size = s;
     }
+    // 引用外部内存，资源对象持有 owner，外部内存至少与资源对象存活一样久
+    // （发送队列只持有资源对象，SIGHUP 替换资源主机后正在发送的正文仍然有效）
+    void setExternalData(const uint8_t* d, uint32_t s, std::shared_ptr<void const> owner){
+        data = const_cast<uint8_t*>(d);
+        size = s;
+        ownsData = false;
+        dataOwner = std::move(owner);
+    }
+    bool moveToArena(std::shared_ptr<ResourceArena> const& a);
+    bool compact();
+
+    void setEtag(std::string_view e) {
+        etag = e;
+    }
+    void setContentEncoding(std::string_view ce) {
+        contentEncoding = ce;
+    }
     void setMimeType(std::string_view mt) {
         mimeType = mt;
     }
+    void setFileStat(uint64_t ino, int64_t mt) {
+        inode = ino;
+        mtime = mt;
+    }
 
     // getter
     std::string getMimeType() const {
         return mimeType;
     }
 
+    std::string getEtag() const {
+        return etag;
+    }
+
+    std::string getContentEncoding() const {
+        return contentEncoding;
+    }
+
     std::string getLocation() const {
         return location;
     }
@@ -45,6 +83,14 @@ public:
         return size;
     }
 
+    uint64_t getInode() const {
+        return inode;
+    }
+
+    int64_t getMtime() const {
+        return mtime;
+    }
+
     // get file name
     std::string getName() const{
         std::string name="";
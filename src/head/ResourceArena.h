@@ -0,0 +1,61 @@
+#ifndef _RESOURCEARENA_H_
+#define _RESOURCEARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr size_t ARENA_REGION_SIZE = 32 * 1024 * 1024;   // 每个区域的大小（2MB 大页的整数倍）
+constexpr size_t ARENA_ALIGN = 64;                       // 块按缓存行对齐
+constexpr size_t ARENA_MAX_BLOCK = ARENA_REGION_SIZE / 4; // 更大的正文不进入 arena
+constexpr double ARENA_SPARSE_RATIO = 0.5;               // 存活字节低于已用字节的该比例时，区域需要整理
+constexpr uint64_t ARENA_COMPACT_BYTES = 4 * 1024 * 1024; // 每秒最多搬移的字节数
+
+// 缓存正文的 arena 分配器
+// 正文从大页支持的大区域中以指针递增方式分配（优先 MAP_HUGETLB，失败时使用 madvise(MADV_HUGEPAGE)），
+// 大量小文件因此共享少量大页，TLB 压力和碎片都远小于逐个 new 的内存块
+// 释放只减少区域的存活字节数；区域完全空闲后被重用。存活率过低的区域由调用者通过 relocate 整理
+// 只能在单个线程（事件循环线程）上使用
+class ResourceArena{
+private:
+    struct Region{
+        uint8_t* base = nullptr;
+        size_t size = 0;
+        size_t used = 0;     // 指针递增的位置
+        size_t live = 0;     // 仍在使用的字节数
+        bool hugetlb = false;
+    };
+    std::vector<Region> regions;
+    size_t current = 0;       // 当前用于分配的区域下标
+    uint64_t mappedBytes = 0;
+    uint64_t liveBytes = 0;
+    uint64_t hugetlbRegions = 0;
+    uint64_t relocatedBytes = 0;
+
+    bool mapRegion();
+    Region* regionOf(const uint8_t* p);
+
+public:
+    ResourceArena() = default;
+    ~ResourceArena();
+    ResourceArena(ResourceArena const&) = delete;
+    ResourceArena& operator=(ResourceArena const&) = delete;
+
+    uint8_t* allocate(size_t len);
+    void release(uint8_t* p, size_t len);
+    bool isSparse(const uint8_t* p);
+    uint8_t* relocate(uint8_t* p, size_t len);
+
+    uint64_t getMappedBytes() const {
+        return mappedBytes;
+    }
+
+    uint64_t getLiveBytes() const {
+        return liveBytes;
+    }
+
+    std::string getMetrics(std::string const& label) const;
+};
+
+#endif
@@ -1,30 +1,147 @@
 #ifndef _RESOURCEHOST_H_
 #define _RESOURCEHOST_H_
 
+#include <ctime>
 #include <string>
+#include<functional>
+#include<list>
 #include<unordered_map>
 #include<memory>
 #include<vector>
 
 #include "Resource.h"
+#include "ResourceArena.h"
+#include "Storage.h"
+
+constexpr uint64_t CONTENT_CACHE_BYTES = 64 * 1024 * 1024;   // 文件内容缓存的默认容量
+constexpr uint32_t CONTENT_CACHE_MAX_OBJECT = 1024 * 1024;   // 大于该值的文件不进入内容缓存
+constexpr time_t CONTENT_CACHE_REVALIDATE = 1;                // 缓存内容确认未过期后，这么多秒内不再确认
+constexpr uint32_t MISSING_CACHE_MAX = 4096;                  // 事件循环侧最多记住的不存在的 URI 数
 
 class ResourceHost{
 private:
-    std::string baseDiskPath;  // 本地文件系统路径
+    std::unique_ptr<Storage> storage;  // 资源的实际来源（磁盘、内存或资源包）
+
+    // 文件内容缓存（LRU），只在事件循环线程上访问
+    // 过了 validUntil 的条目照常返回，同时由 I/O 线程在后台向存储后端确认（事件循环不访问后端的锁和文件系统）
+    struct ContentEntry{
+        std::shared_ptr<Resource> res;
+        std::list<std::string>::iterator lru;
+        time_t validUntil;
+    };
+    std::unordered_map<std::string, ContentEntry> contentCache;
+    std::list<std::string> contentLru;   // 最近使用的在前
+    uint64_t contentBytes = 0;
+    uint64_t contentBudget = CONTENT_CACHE_BYTES;
+    std::shared_ptr<ResourceArena> arena;   // 缓存正文所在的大页 arena
 
-    std::string lookupMImeType(std::string const& ext) const;
+    // 正在加载的 URI -> 等待该次加载结果的回调（single-flight），只在事件循环线程上访问
+    std::unordered_map<std::string, std::vector<std::function<void(std::shared_ptr<Resource>)>>> inflight;
 
-    std::unique_ptr<Resource> readFile(std::string const& path, struct stat const& sb);   //  从 FS 将文件读入资源对象
+    void eraseContent(std::unordered_map<std::string, ContentEntry>::iterator it);
 
-    std::unique_ptr<Resource> readDirectory(std::string path, struct stat const& sb);  // 将目录列表或索引从 FS 读入资源对象
+    // 事件循环侧的负缓存：后端确认不存在的 URI -> 监视其祖先目录的 wd（LRU），只在事件循环线程上访问
+    // 命中时不再提交加载任务；该目录的变更通知到达时失效
+    struct MissingEntry{
+        int32_t wd;
+        std::list<std::string>::iterator lru;
+    };
+    std::unordered_map<std::string, MissingEntry> missing;
+    std::list<std::string> missingLru;   // 最近使用的在前
+    uint64_t notifySeq = 0;              // 每处理一批变更通知加一
 
-    std::string generateDirList(std::string const& dirPath) const;  // 根据 URI 提供目录列表的字符串
+    // 绑定到该主机的客户端连接数及其上限（0 表示不限），只在事件循环线程上访问
+    uint32_t connections = 0;
+    uint32_t connectionLimit = 0;
 
 public:
-    explicit ResourceHost(std::string const& base);
+    explicit ResourceHost(std::string const& base, std::string const& storageType = "disk");
     ~ResourceHost() = default;
 
-    std::unique_ptr<Resource> getResource(std::string const& uri);
+    // 可能阻塞，可在 I/O 线程上调用
+    std::unique_ptr<Resource> getResource(std::string const& uri) {
+        return storage->load(uri);
+    }
+
+    // 不阻塞的后端（内存、资源包）直接在事件循环线程上查找
+    bool isNonBlocking() const {
+        return storage->isNonBlocking();
+    }
+    std::shared_ptr<Resource> lookupResource(std::string const& uri, bool acceptGzip) {
+        return storage->lookup(uri, acceptGzip);
+    }
+
+    void prefetch(std::string const& uri) {
+        storage->prefetch(uri);
+    }
+
+    // 缓存的资源是否仍与后端一致，可能阻塞，可在 I/O 线程上调用
+    bool isFresh(Resource const& res) {
+        return storage->isFresh(res);
+    }
+
+    // 后端负缓存中该 URI 所挂的被监视目录，不存在时为 -1，可在 I/O 线程上调用
+    int32_t getMissingWatch(std::string const& uri) {
+        return storage->getMissingWatch(uri);
+    }
+
+    // 事件循环侧的负缓存（仅限事件循环线程）
+    bool isMissing(std::string const& uri);
+    void addMissing(std::string const& uri, int32_t wd, uint64_t seq);
+    uint64_t getNotifySeq() const {
+        return notifySeq;
+    }
+
+    // 内容缓存（仅限事件循环线程）
+    std::shared_ptr<Resource> getCachedResource(std::string const& uri, bool* stale = nullptr);
+    std::shared_ptr<Resource> getExpiredResource(std::string const& uri);
+    void cacheResource(std::string const& uri, std::shared_ptr<Resource> res);
+    void setCacheBudget(uint64_t bytes);
+    uint64_t compactCache(uint64_t maxBytes);
+
+    std::string getArenaMetrics(std::string const& label) const {
+        return arena->getMetrics(label);
+    }
+
+    uint64_t getCacheBytes() const {
+        return contentBytes;
+    }
+
+    uint64_t getCacheBudget() const {
+        return contentBudget;
+    }
+
+    // 合并对同一 URI 的并发加载（仅限事件循环线程）
+    bool joinLoad(std::string const& uri, std::function<void(std::shared_ptr<Resource>)> waiter);
+    void finishLoad(std::string const& uri, std::shared_ptr<Resource> res);
+    void cancelLoads();
+    bool isLoading(std::string const& uri) const {
+        return inflight.contains(uri);
+    }
+
+    // 连接数上限（仅限事件循环线程）
+    bool acquireConnection() {
+        if (connectionLimit != 0 && connections >= connectionLimit)
+            return false;
+        ++connections;
+        return true;
+    }
+    void releaseConnection() {
+        if (connections > 0)
+            --connections;
+    }
+    void setConnectionLimit(uint32_t limit) {
+        connectionLimit = limit;
+    }
+    uint32_t getConnections() const {
+        return connections;
+    }
+
+    // 变更通知描述符（由 HTTPServer 注册到事件循环），不支持时为 -1
+    int32_t getNotifyFd() const {
+        return storage->getNotifyFd();
+    }
+    void processNotifications();
 };
 
-#endif
\ No newline at end of file
+#endif
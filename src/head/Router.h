@@ -0,0 +1,83 @@
+#ifndef _ROUTER_H_
+#define _ROUTER_H_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Client;
+class HTTPRequest;
+
+constexpr uint32_t ROUTE_MAX_PARAMS = 8;   // 一条路由最多捕获的参数数
+
+// 方法掩码：1 << Method
+constexpr uint32_t methodBit(uint32_t method){
+    return 1u << method;
+}
+constexpr uint32_t ROUTE_ANY_METHOD = 0x1FF;   // 所有 NUM_METHODS 个方法
+
+// 路由匹配时捕获的参数，值指向请求 URI，不做任何分配
+struct RouteParams{
+    uint32_t count = 0;
+    std::array<std::string_view, ROUTE_MAX_PARAMS> names;
+    std::array<std::string_view, ROUTE_MAX_PARAMS> values;
+
+    std::string_view get(std::string_view name) const {
+        for (uint32_t i = 0; i < count; ++i){
+            if (names[i] == name)
+                return values[i];
+        }
+        return {};
+    }
+};
+
+using RouteHandler = std::function<void(std::shared_ptr<Client>, std::shared_ptr<HTTPRequest>, RouteParams const&)>;
+
+// 路由表（基数树）
+// 在启动时注册，匹配 方法 + 路径。路径模式由三种片段组成：
+//   静态文本      /health
+//   命名参数      /users/:id        匹配一个不含 '/' 的片段
+//   通配后缀      /static/*path     匹配剩余的全部路径（前缀路由），"*" 单独使用时匹配任何 URI
+// 匹配优先级：静态文本 > 参数 > 通配；路径匹配但方法不匹配时回溯到优先级更低的路由
+// 查找只使用 string_view 和固定大小的参数数组，不分配内存
+class Router{
+private:
+    struct Route{
+        uint32_t methods;
+        RouteHandler handler;
+    };
+    struct Node{
+        std::string label;                           // 静态边的文本
+        std::vector<std::unique_ptr<Node>> children; // 静态子节点，首字符互不相同
+        std::unique_ptr<Node> param;                 // 参数子节点
+        std::string paramName;
+        std::unique_ptr<Node> wildcard;              // 通配子节点（只有路由，没有子节点）
+        std::string wildcardName;
+        std::vector<Route> routes;
+    };
+    Node root;
+    uint32_t routeCount = 0;
+
+    bool insert(Node& node, std::string_view path, uint32_t methods, RouteHandler const& handler);
+    static RouteHandler const* findRoute(Node const& node, uint32_t methods);
+    RouteHandler const* match(Node const& node, std::string_view path, uint32_t method, RouteParams& params) const;
+
+public:
+    Router() = default;
+    ~Router() = default;
+    Router(Router const&) = delete;
+    Router& operator=(Router const&) = delete;
+
+    bool add(uint32_t methods, std::string_view pattern, RouteHandler handler);
+    RouteHandler const* lookup(uint32_t method, std::string_view path, RouteParams& params) const;
+
+    uint32_t size() const {
+        return routeCount;
+    }
+};
+
+#endif
@@ -6,16 +6,20 @@
 
 // Object 代表  客户端发送队列中的一段数据
 // 包含一个指向发送缓冲区的指针，并跟踪当前发送的数据量（通过offset）。
+// 数据可以由项目自己持有，也可以借用其他对象的内存（例如缓存中资源的正文），由 owner 保证发送完之前不被释放
 
 class SendQueueItem{
 private:
     std::unique_ptr<uint8_t[]> sendData;
+    std::shared_ptr<void const> owner;   // 借用的数据的持有者
+    const uint8_t* borrowed = nullptr;
     uint32_t sendSize;
     uint32_t sendOffset = 0;
     bool disconnect;   //  flag，指示是否应在此项目重新排队后断开客户端连接
 
 public:
     SendQueueItem(std::unique_ptr<uint8_t[]> data, uint32_t size, bool dc) :sendData(std::move(data)), sendSize(size), disconnect(dc){}
+    SendQueueItem(std::shared_ptr<void const> o, const uint8_t* data, uint32_t size, bool dc) :owner(std::move(o)), borrowed(data), sendSize(size), disconnect(dc){}
     ~SendQueueItem() = default;
     SendQueueItem(SendQueueItem const&) = delete;  // 禁用拷贝构造
     SendQueueItem& operator=(SendQueueItem const&) = delete;
@@ -26,14 +30,18 @@ public:
         sendOffset = off;
     }
 
-    uint8_t* getRawDataPointer() const {
-        return sendData.get();
+    const uint8_t* getRawDataPointer() const {
+        return sendData != nullptr ? sendData.get() : borrowed;
     }
 
     uint32_t getSize() const{
         return sendSize;
     }
 
+    void setDisconnect(bool dc){
+        disconnect = dc;
+    }
+
     bool getDisconnect() const{
         return disconnect;
     }
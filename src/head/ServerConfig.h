@@ -0,0 +1,40 @@
+#ifndef _SERVERCONFIG_H_
+#define _SERVERCONFIG_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 带独立 docroot 的虚拟主机：vhost.<host>=<storage>:<path>
+struct VhostSpec{
+    std::string host;
+    std::string storage;
+    std::string path;
+};
+
+// server.config 的解析结果
+// 文件格式为每行 key=value，空行和 # 开头的行被忽略；启动和 SIGHUP 重新加载都使用它
+class ServerConfig{
+public:
+    std::map<std::string, std::string, std::less<>> values;   // 所有 key=value
+
+    // 常用字段，load() 时从 values 中解析
+    int32_t port = 0;
+    std::string diskpath = "";
+    std::string storage = "disk";              // diskpath 的存储后端
+    std::vector<std::string> vhostAliases;     // vhost=a,b,c，与 diskpath 共用资源主机
+    std::vector<VhostSpec> vhosts;             // vhost.<host>=<storage>:<path>
+    std::string defaultVhost = "";
+
+    bool load(std::string const& path);
+
+    bool contains(std::string_view key) const {
+        return values.contains(key);
+    }
+    std::string get(std::string_view key, std::string const& def = "") const;
+    int64_t getInt(std::string_view key, int64_t def = 0) const;
+};
+
+#endif
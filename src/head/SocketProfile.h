@@ -0,0 +1,28 @@
+#ifndef _SOCKETPROFILE_H_
+#define _SOCKETPROFILE_H_
+
+#include "ServerConfig.h"
+
+#include <cstdint>
+#include <sys/socket.h>
+
+constexpr uint32_t ACCEPT_BATCH = 64;   // 每个就绪事件最多接受的连接数，避免饿死其他事件
+
+// 监听套接字的选项，值为 0 表示保持系统默认
+// 只设置在监听套接字上：Linux 上 accept() 得到的连接继承监听套接字的 TCP_NODELAY、缓冲区大小、
+// TCP_NOTSENT_LOWAT 和 SO_BUSY_POLL，每个连接不需要额外的系统调用
+struct SocketProfile{
+    bool noDelay = true;          // TCP_NODELAY，响应分多次写出时不等待 ACK
+    int32_t deferAccept = 0;      // TCP_DEFER_ACCEPT（秒），数据到达后才唤醒 accept
+    int32_t fastOpen = 0;         // TCP_FASTOPEN 的队列长度
+    int32_t sndBuf = 0;           // SO_SNDBUF（字节）
+    int32_t rcvBuf = 0;           // SO_RCVBUF（字节）
+    int32_t notSentLowat = 0;     // TCP_NOTSENT_LOWAT（字节），内核中未发送的数据低于它时才报告可写
+    int32_t busyPoll = 0;         // SO_BUSY_POLL（微秒）
+    int32_t backlog = SOMAXCONN;  // listen() 的积压队列长度
+
+    static SocketProfile fromConfig(ServerConfig const& cfg);
+    void applyListener(int32_t fd) const;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Resource.h"
+
+// 存储后端接口
+// ResourceHost 通过它查找资源，具体实现决定资源来自磁盘、内存还是映射的资源包
+class Storage{
+protected:
+    static std::string lookupMimeType(std::string const& ext);
+
+public:
+    virtual ~Storage() = default;
+
+    // 加载资源。可能阻塞，实现必须是线程安全的（会在 I/O 线程上调用）
+    // @param uri 请求中发送的 URI（可带查询字符串）
+    virtual std::unique_ptr<Resource> load(std::string const& uri) = 0;
+
+    // 为 true 时 lookup() 总能在事件循环线程上立即给出结果，无需 I/O 线程池和内容缓存
+    virtual bool isNonBlocking() const {
+        return false;
+    }
+    virtual std::shared_ptr<Resource> lookup([[maybe_unused]] std::string const& uri, [[maybe_unused]] bool acceptGzip) {
+        return nullptr;
+    }
+
+    // 提示后端资源即将被读取（例如让内核提前读入页缓存），不阻塞
+    virtual void prefetch([[maybe_unused]] std::string const& uri) {}
+
+    // 内容缓存中的资源是否仍然有效（可能阻塞，只在 I/O 线程上调用）
+    virtual bool isFresh([[maybe_unused]] Resource const& res) {
+        return true;
+    }
+
+    // 变更通知描述符（由事件循环监视），不支持时为 -1
+    virtual int32_t getNotifyFd() const {
+        return -1;
+    }
+    // 处理变更通知（事件循环线程，不阻塞），返回发生变化的被监视目录
+    virtual std::vector<int32_t> processNotifications() {
+        return {};
+    }
+    // 已确认不存在的 URI 所挂的被监视目录，不在负缓存中时返回 -1（只在 I/O 线程上调用）
+    virtual int32_t getMissingWatch([[maybe_unused]] std::string const& uri) {
+        return -1;
+    }
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef _TASK_H_
+#define _TASK_H_
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+
+constexpr size_t FRAME_POOL_MIN = 128;      // 最小的帧大小档位
+constexpr uint32_t FRAME_POOL_CLASSES = 6;  // 档位数：128、256 ... 4096 字节，更大的帧直接使用 operator new
+constexpr uint32_t FRAME_POOL_KEEP = 256;   // 每个档位最多缓存的空闲帧数
+
+// 协程帧分配器
+// 按大小档位缓存释放的帧，处理请求时不再为每个协程帧访问全局堆
+// 空闲链表是线程局部的，协程帧只在事件循环线程上创建和销毁
+class FramePool{
+public:
+    static void* allocate(size_t n);
+    static void release(void* p, size_t n);
+    static std::string getMetrics();
+};
+
+// 协程任务
+// 惰性启动：被 co_await 时才开始执行，结束后通过对称转移恢复等待者；
+// 顶层任务由 detach() 启动，结束时自行销毁协程帧
+// 所有协程都在事件循环线程上恢复，由 HTTPServer 的 awaitable 负责调度
+class Task{
+public:
+    struct promise_type{
+        std::coroutine_handle<> continuation;  // co_await 本任务的协程
+        bool detached = false;
+
+        Task get_return_object() {
+            return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter{
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                auto& p = h.promise();
+                if (p.continuation)
+                    return p.continuation;
+                if (p.detached)
+                    h.destroy();
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {}
+        // 处理函数不使用异常，出现异常说明程序有错误
+        void unhandled_exception() {
+            std::terminate();
+        }
+
+        static void* operator new(size_t n) {
+            return FramePool::allocate(n);
+        }
+        static void operator delete(void* p, size_t n) {
+            FramePool::release(p, n);
+        }
+    };
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(other.handle) {
+        other.handle = nullptr;
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other){
+            if (handle)
+                handle.destroy();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+    ~Task(){
+        if (handle)
+            handle.destroy();
+    }
+
+    // 启动顶层任务，任务结束时自行销毁
+    void detach(){
+        auto h = handle;
+        handle = nullptr;
+        if (h){
+            h.promise().detached = true;
+            h.resume();
+        }
+    }
+
+    // co_await 子任务：启动子任务，子任务结束后恢复当前协程
+    bool await_ready() const noexcept {
+        return !handle || handle.done();
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) noexcept {
+        handle.promise().continuation = cont;
+        return handle;
+    }
+    void await_resume() const noexcept {}
+
+    // 销毁挂起在 h 处的协程（服务器停止时丢弃尚未完成的协程）
+    // 子任务的帧由等待它的任务中的 Task 对象持有，因此沿 continuation 找到最外层的顶层任务再销毁，子任务随之销毁
+    // h 必须是挂起中的 Task 协程
+    static void destroySuspended(std::coroutine_handle<> h){
+        auto t = std::coroutine_handle<promise_type>::from_address(h.address());
+        while (t.promise().continuation)
+            t = std::coroutine_handle<promise_type>::from_address(t.promise().continuation.address());
+        t.destroy();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle = nullptr;
+};
+
+#endif
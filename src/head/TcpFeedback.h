@@ -0,0 +1,33 @@
+#ifndef _TCPFEEDBACK_H_
+#define _TCPFEEDBACK_H_
+
+#include <cstdint>
+
+// 内核中未发送数据的目标为 BDP（cwnd × MSS）的 TCP_BDP_FACTOR 倍：ACK 返回、cwnd 打开时总有数据可发，
+// 又不会把整个响应都堆进内核
+constexpr uint32_t TCP_BDP_FACTOR = 2;
+constexpr uint32_t TCP_MIN_UNSENT = 16 * 1024;          // 目标的下限（新连接的 cwnd 很小）
+constexpr uint32_t TCP_MAX_UNSENT = 8 * 1024 * 1024;    // 目标的上限
+constexpr int64_t TCP_SAMPLE_MIN_US = 10 * 1000;        // 采样间隔为一个 RTT，限制在这个范围内
+constexpr int64_t TCP_SAMPLE_MAX_US = 200 * 1000;
+
+// 一个连接的发送状态（TCP_INFO 的采样结果）
+struct TcpSendState{
+    int64_t nextSampleUs = 0;   // 下次采样的时间（单调时钟，微秒）
+    uint32_t target = 0;        // 内核中未发送数据的目标，也是当前的 TCP_NOTSENT_LOWAT；0 表示尚未采样
+    uint32_t cwndBytes = 0;     // cwnd × MSS
+    uint32_t rttUs = 0;         // 平滑的 RTT
+    int32_t sndBuf = 0;         // 当前的 SO_SNDBUF（内核报告的值）
+    bool sndBufCapped = false;  // 已达到上限，不再增大
+};
+
+// 从套接字的实际状态确定发送量（Linux；其他平台上 sample() 返回 false，由调用者沿用写事件报告的可用空间）
+// 每个 RTT 采样一次 TCP_INFO，按 cwnd 计算未发送数据的目标并设置为 TCP_NOTSENT_LOWAT，
+// 内核只在未发送的数据低于目标时才报告可写，事件循环不会因为暂时不发送而空转
+class TcpFeedback{
+public:
+    static bool sample(int32_t fd, TcpSendState& st, int64_t nowUs, int32_t sndBufMax, bool& grown);
+    static int64_t unsent(int32_t fd);
+};
+
+#endif
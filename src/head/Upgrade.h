@@ -0,0 +1,27 @@
+#ifndef _UPGRADE_H_
+#define _UPGRADE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// 新进程从这个环境变量得知与旧进程之间的 Unix 套接字描述符
+constexpr char UPGRADE_ENV[] = "HTTPSERVER_UPGRADE_FD";
+constexpr int32_t UPGRADE_CHANNEL_FD = 3;       // 新进程中该套接字固定为描述符 3
+constexpr int32_t UPGRADE_DRAIN_SECONDS = 30;   // 旧进程等待已有连接结束的最长时间
+constexpr char UPGRADE_ACK = 'A';               // 新进程开始监听后发回的确认字节
+
+// 不停机升级：旧进程 fork 并 exec 新的二进制文件，通过 socketpair 用 SCM_RIGHTS 传递监听套接字。
+// 新进程收到套接字、开始接受连接后回复确认，旧进程随即停止接受连接并等待已有连接结束
+class Upgrade{
+public:
+    static bool sendFd(int32_t sock, int32_t fd, void const* data = nullptr, size_t len = 0);
+    static int32_t recvFd(int32_t sock, void* data = nullptr, size_t len = 0);
+
+    static pid_t spawn(std::vector<std::string> const& args, int32_t listenFd, int32_t& channel);
+    static int32_t takeInheritedChannel();
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _VHOSTGENERATION_H_
+#define _VHOSTGENERATION_H_
+
+#include "HostTable.h"
+#include "Resourcehost.h"
+#include "Router.h"
+#include "ServerConfig.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 一代虚拟主机配置：资源主机、主机表和各主机的路由表
+// 构建完成后只读；SIGHUP 时在 I/O 线程上构建新的一代，再由事件循环整体替换。
+// 正在处理的请求持有旧资源主机的引用，在旧的一代上完成
+struct VhostGeneration{
+    uint64_t id = 0;
+    std::vector<std::shared_ptr<ResourceHost>> hostList;  // 包含所有资源主机，hostList[0] 为 diskpath
+    HostTable hostTable;   // 虚拟主机。将主机名映射到资源主机，以便为请求提供服务
+    // 主机名 -> 该主机自己的路由表；按名字而不是资源主机区分，共用后端的别名和虚拟主机不会共享路由
+    std::unordered_map<std::string, std::unique_ptr<Router>, HostTable::CaseInsensitiveHash, HostTable::CaseInsensitiveEqual> hostRouters;
+    std::unordered_map<std::string, std::shared_ptr<ResourceHost>> bySpec;   // "<storage>:<path>" -> 资源主机
+    uint32_t reused = 0;   // 从上一代沿用的资源主机数（保留其缓存）
+
+    std::shared_ptr<ResourceHost> getHost(std::string const& storage, std::string const& path, VhostGeneration const* previous);
+    void addPrimary(std::string const& diskpath, std::string const& storage, std::vector<std::string> const& aliases, VhostGeneration const* previous);
+    bool addVhost(std::string const& host, std::string const& storage, std::string const& path, VhostGeneration const* previous);
+
+    static std::shared_ptr<VhostGeneration> build(ServerConfig const& cfg, VhostGeneration const* previous);
+};
+
+#endif
@@ -2,10 +2,15 @@
 #include <string>
 #include <unordered_map>
 #include <fstream>
+#include <algorithm>
+#include <vector>
 #include <signal.h>
 
 #include "HTTPserver.h"
+#include "Master.h"
+#include "RateLimiter.h"
 #include "Resourcehost.h"
+#include "ServerConfig.h"
 
 static std::unique_ptr<HTTPServer> svr;
 
@@ -19,74 +24,173 @@ void handleTermSig([[maybe_unused]] int32_t snum){
     svr->canRun = false;
 }
 
-int main()
-{
-    // 解析配置文件
-    std::map<std::string, std::string, std::less<>> config;
-    std::fstream cfile;
-    std::string line;
-    std::string key;
-    std::string val;
-    int32_t epos = 0;
-    int32_t drop_uid = 0;
-    int32_t drop_gid = 0;
-    cfile.open("server.config");
-    if (!cfile.is_open()){
-        std::cout << "Unable to open server.config file in working directory" << std::endl;
-        return -1;
+// 重新加载配置信号处理器：只通知事件循环，加载在事件循环中进行
+void handleReloadSig([[maybe_unused]] int32_t snum){
+    svr->notifyReload();
+}
+
+// 不停机升级信号处理器：只通知事件循环
+void handleUpgradeSig([[maybe_unused]] int32_t snum){
+    svr->notifyUpgrade();
+}
+
+// 读取预热清单
+// 每行一个 URI，或 "<host> <URI>" 指定虚拟主机；空行和 # 开头的行被忽略
+// @param path 清单文件路径
+// @return (主机名, URI) 列表
+static std::vector<std::pair<std::string, std::string>> readWarmupManifest(std::string const& path){
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::ifstream file(path);
+    if (!file.is_open()){
+        std::cout << "Unable to open warm-up manifest " << path << std::endl;
+        return entries;
     }
-    while (getline(cfile, line)){
-        // 跳过空行 或以a#开头
-        if (line.length() == 0 || line.rfind("#", 0) == 0)
+    std::string line;
+    while (getline(file, line)){
+        if (line.empty() || line[0] == '#')
             continue;
-        epos = line.find("=");
-        key = line.substr(0, epos);
-        val = line.substr(epos + 1, line.length());
-        config.try_emplace(key, val);
+        if (size_t sp = line.find(' '); sp != std::string::npos)
+            entries.emplace_back(line.substr(0, sp), line.substr(sp + 1));
+        else
+            entries.emplace_back("", line);
     }
-    cfile.close();
-    // 验证 vhost、端口和磁盘路径是否存在
-    if (!config.contains("vhost") || !config.contains("port") || !config.contains("diskpath")) {
-        std::cout << "vhost, port, and diskpath must be supplied in the config, at a minimum" << std::endl;
-        return -1;
+    return entries;
+}
+
+// 从上次运行的访问日志中选出请求次数最多的 URI
+// 日志行的格式与 handleRequest() 输出的一致："[<ip>] GET <uri>"
+// @param path 日志文件路径
+// @param top 最多返回的 URI 数
+// @return (空主机名, URI) 列表，按请求次数降序
+static std::vector<std::pair<std::string, std::string>> readWarmupLog(std::string const& path, uint32_t top){
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::ifstream file(path);
+    if (!file.is_open()){
+        std::cout << "Unable to open access log " << path << std::endl;
+        return entries;
+    }
+    std::unordered_map<std::string, uint32_t> counts;
+    std::string line;
+    while (getline(file, line)){
+        size_t pos = line.find("] ");
+        if (line.empty() || line[0] != '[' || pos == std::string::npos)
+            continue;
+        pos += 2;
+        if (line.compare(pos, 4, "GET ") == 0)
+            pos += 4;
+        else if (line.compare(pos, 5, "HEAD ") == 0)
+            pos += 5;
+        else
+            continue;
+        std::string uri = line.substr(pos, line.find(' ', pos) - pos);
+        if (!uri.empty() && uri[0] == '/')
+            ++counts[uri];
     }
-    // 将 vhost 分解为逗号分隔的列表（如果有多个 vhost 别名）
-    std::vector<std::string> vhosts;
-    std::string vhost_alias_str = config["vhost"];
-    std::string delimiter = ",";
-    std::string token;
-    size_t pos = 0;
-    do {
-        pos = vhost_alias_str.find(delimiter);
-        token = vhost_alias_str.substr(0, pos);
-        vhosts.push_back(token);
-        vhost_alias_str.erase(0, pos + delimiter.length());
-    } while (pos != std::string::npos);
 
-    // 检查可选的 drop_uid、drop_gid。 确保均已设置
-    if (config.contains("drop_uid") && config.contains("drop_gid")) {
-        drop_uid = atoi(config["drop_uid"].c_str());
-        drop_gid = atoi(config["drop_gid"].c_str());
+    std::vector<std::pair<std::string, uint32_t>> sorted(counts.begin(), counts.end());
+    size_t n = std::min<size_t>(top, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(),
+                      [](auto const& a, auto const& b){ return a.second > b.second; });
+    for (size_t i = 0; i < n; ++i)
+        entries.emplace_back("", sorted[i].first);
+    return entries;
+}
+
+// 运行服务器，直到收到终止信号
+// @param cfg 配置
+// @param args 命令行，用于 SIGUSR2 升级
+// @param drop_uid bind() 之后切换到的 uid
+// @param drop_gid bind() 之后切换到的 gid
+// @param listenFd prefork 时 master 创建的监听套接字，否则为 INVALID_SOCKET
+// @param stats prefork 时的计数器共享内存
+// @param slot 工作进程的槽位
+// @param limiter 按 IP 限速的令牌桶表，未启用时为 NULL
+// @return 进程退出码
+static int32_t serve(ServerConfig& cfg, std::vector<std::string> const& args, int32_t drop_uid, int32_t drop_gid,
+                     int32_t listenFd, StatsSegment* stats, uint32_t slot, RateLimiter* limiter){
+    auto& config = cfg.values;
+    // 可选的磁盘 I/O 线程数
+    uint32_t io_threads = IO_POOL_THREADS;
+    if (config.contains("io_threads") && atoi(config["io_threads"].c_str()) > 0)
+        io_threads = atoi(config["io_threads"].c_str());
+
+    // 可选的 CPU 线程数（大响应的构造）
+    uint32_t cpu_threads = CPU_POOL_THREADS;
+    if (config.contains("cpu_threads") && atoi(config["cpu_threads"].c_str()) > 0)
+        cpu_threads = atoi(config["cpu_threads"].c_str());
 
-        if (drop_uid <= 0 || drop_gid <= 0) {
-            // Both must be set, otherwise set back to 0 so we dont use
-            drop_uid = drop_gid = 0;
-        }
-    }
     // 当套接字连接中断时，忽略 SIGPIPE “管道破裂 ”信号。
     signal(SIGPIPE, handleSigPipe);
     // 寄存器终止信号
     signal(SIGABRT, &handleTermSig);
     signal(SIGINT, &handleTermSig);
     signal(SIGTERM, &handleTermSig);
+    // SIGHUP 重新加载虚拟主机配置，不断开连接
+    signal(SIGHUP, &handleReloadSig);
+    // SIGUSR2 启动新的二进制文件并把监听套接字交给它，本进程排空后退出
+    signal(SIGUSR2, &handleUpgradeSig);
 
     // 实例化并启动服务器
-    svr = std::make_unique<HTTPServer>(vhosts, atoi(config["port"].c_str()), 
-                                        config["diskpath"], drop_uid, drop_gid);
+    svr = std::make_unique<HTTPServer>(cfg.vhostAliases, cfg.port,
+                                        cfg.diskpath, drop_uid, drop_gid, io_threads, cfg.storage, cpu_threads);
+    svr->setConfigPath("server.config");
+    // 可选的套接字选项：tcp_nodelay、tcp_defer_accept、tcp_fastopen、so_sndbuf、so_rcvbuf、
+    // tcp_notsent_lowat、so_busy_poll、listen_backlog
+    svr->setSocketProfile(SocketProfile::fromConfig(cfg));
+    // prefork 时由 master 绑定监听套接字，工作进程不支持 SIGUSR2 升级
+    if (listenFd != INVALID_SOCKET){
+        svr->setListenSocket(listenFd);
+        svr->setWorkerStats(stats, slot);
+    } else {
+        svr->setExecArgs(args);
+    }
+    // 带有独立 docroot 的虚拟主机：vhost.<host>=<storage>:<path>
+    for (auto const& spec : cfg.vhosts)
+        svr->addVhost(spec.host, spec.storage, spec.path);
+    // 可选的默认虚拟主机：HTTP/1.0 请求和 Host 未匹配的请求由它响应
+    if (!cfg.defaultVhost.empty() && !svr->setDefaultVhost(cfg.defaultVhost))
+        return -1;
+
+    // 可选的连接数上限、过载保护和按 IP 限速：max_connections、max_connections.<host>、overload_target_ms、
+    // rate_limit、rate_limit_burst
+    svr->setRateLimiter(limiter);
+    svr->applyAdmissionConfig(cfg);
+    svr->applyEndpointConfig(cfg);
+
+    // 自适应发送量（默认启用）：adaptive_send=0 关闭；so_sndbuf_max=<字节> 允许为高 BDP 的连接增大 SO_SNDBUF
+    svr->setSendSizing(cfg.getInt("adaptive_send", 1) != 0, cfg.getInt("so_sndbuf_max", 0));
+
+    // 可选的写调度：剩余待发送量不超过 write_priority_kb（KB）的小响应优先发送，0 表示不区分
+    if (config.contains("write_priority_kb"))
+        svr->setWritePriority(cfg.getInt("write_priority_kb") << 10);
+
+    // 可选的内容缓存预算上下限（MB），实际预算由内存压力控制器在两者之间调整
+    if (config.contains("cache_min_mb") || config.contains("cache_max_mb")){
+        uint64_t min_mb = config.contains("cache_min_mb") ? atoi(config["cache_min_mb"].c_str()) : MEMCTL_MIN_BUDGET >> 20;
+        uint64_t max_mb = config.contains("cache_max_mb") ? atoi(config["cache_max_mb"].c_str()) : MEMCTL_MAX_BUDGET >> 20;
+        svr->setCacheLimits(min_mb << 20, max_mb << 20);
+    }
+
+    // 可选的缓存预热：warmup_manifest=<清单文件>，或 warmup_log=<访问日志> 与 warmup_top=<N>
+    std::vector<std::pair<std::string, std::string>> warm;
+    if (config.contains("warmup_manifest"))
+        warm = readWarmupManifest(config["warmup_manifest"]);
+    if (config.contains("warmup_log")){
+        uint32_t top = 1000;
+        if (config.contains("warmup_top") && atoi(config["warmup_top"].c_str()) > 0)
+            top = atoi(config["warmup_top"].c_str());
+        auto hot = readWarmupLog(config["warmup_log"], top);
+        warm.insert(warm.end(), hot.begin(), hot.end());
+    }
+    svr->warmUp(warm);
+
     if (!svr->start()) {
         svr->stop();
         return -1;
     }
+    // prefork 工作进程：处理函数已可以通知事件循环，放开 master 在 fork 时保留屏蔽的 SIGHUP/SIGUSR2
+    if (listenFd != INVALID_SOCKET)
+        Master::releaseWorkerSignals();
     // Run main event loop
     svr->process();
 
@@ -94,4 +198,44 @@ int main()
     svr->stop();
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv)
+{
+    // 解析配置文件（同时验证 vhost、端口和磁盘路径是否存在）
+    ServerConfig cfg;
+    if (!cfg.load("server.config"))
+        return -1;
+    auto& config = cfg.values;
+    int32_t drop_uid = 0;
+    int32_t drop_gid = 0;
+
+    // 检查可选的 drop_uid、drop_gid。 确保均已设置
+    if (config.contains("drop_uid") && config.contains("drop_gid")) {
+        drop_uid = atoi(config["drop_uid"].c_str());
+        drop_gid = atoi(config["drop_gid"].c_str());
+
+        if (drop_uid <= 0 || drop_gid <= 0) {
+            // Both must be set, otherwise set back to 0 so we dont use
+            drop_uid = drop_gid = 0;
+        }
+    }
+    // 可选的按 IP 限速：令牌桶表在 fork 之前映射，所有工作进程共享同一份计数
+    RateLimiter limiter;
+    bool limit = cfg.getInt("rate_limit") > 0;
+    if (limit && !limiter.init(cfg.getInt("rate_limit_table", RATE_LIMIT_TABLE_SIZE)))
+        return -1;
+
+    // 可选的 prefork 模式：master 绑定端口后 fork 出 workers 个工作进程，崩溃的工作进程会被立即重启
+    if (int64_t workers = cfg.getInt("workers"); workers > 0){
+        Master master(workers);
+        if (!master.listen(cfg.port, drop_uid, drop_gid, SocketProfile::fromConfig(cfg)))
+            return -1;
+        return master.run([&](uint32_t slot){
+            return serve(cfg, {}, drop_uid, drop_gid, master.getListenSocket(), master.getStats(), slot,
+                         limit ? &limiter : nullptr);
+        });
+    }
+    return serve(cfg, std::vector<std::string>(argv, argv + argc), drop_uid, drop_gid, INVALID_SOCKET, nullptr, 0,
+                 limit ? &limiter : nullptr);
+}